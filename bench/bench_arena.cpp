@@ -0,0 +1,119 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <bvh.h>
+#include <scene_arena.h>
+#include <scenes.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Heap allocations made by a thread while an allocation_counter of it is
+// alive, so the suite can report what building a scene costs. Outside one,
+// operator new is plain malloc plus a thread_local test, so the other
+// suites of the binary are not slowed down.
+struct allocation_counter
+{
+    long long allocations = 0;
+    long long bytes = 0;    // requested, including blocks freed again
+    allocation_counter* previous;
+
+    allocation_counter() : previous(active()) { active() = this; }
+    ~allocation_counter() { active() = previous; }
+
+    static allocation_counter*& active() {
+        static thread_local allocation_counter* counter = nullptr;
+        return counter;
+    }
+};
+
+void* operator new(size_t size) {
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    if (allocation_counter* counter = allocation_counter::active()) {
+        counter->allocations++;
+        counter->bytes += static_cast<long long>(size);
+    }
+    return p;
+}
+
+// GCC sees free() paired with new once these are inlined, not knowing this
+// operator new is malloc.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Objects of every alignment, interleaved and across block boundaries,
+// must come out aligned and be destroyed exactly once.
+struct alignas(32) wide_object
+{
+    static int live;
+    char bytes[40];
+    wide_object() { live++; }
+    ~wide_object() { live--; }
+};
+int wide_object::live = 0;
+
+static bool check_alignment() {
+    bool ok = true;
+    {
+        scene_arena arena(256);
+        for (int k = 0; k < 100; k++) {
+            arena.make<char>('x');
+            ok &= reinterpret_cast<uintptr_t>(arena.make<wide_object>().get()) % alignof(wide_object) == 0;
+            arena.make<short>(short(k));
+            ok &= reinterpret_cast<uintptr_t>(arena.make<double>(k).get()) % alignof(double) == 0;
+        }
+        ok &= wide_object::live == 100;
+    }
+    return ok && wide_object::live == 0;
+}
+
+// Generated sphere scenes built with one make_shared per sphere and from a
+// scene_arena: build time, heap allocations and heap bytes requested while
+// building, then the time to build a bvh over the result and to free the
+// scene.
+void bench_arena() {
+    printf("over-aligned objects: %s\n", check_alignment() ? "ok" : "FAILED");
+    printf("%10s %8s %10s %12s %10s %10s %10s\n", "spheres", "alloc", "build ms", "allocations", "MB", "bvh ms", "free ms");
+
+    for (int count : { 100000, 1000000 }) {
+        for (bool use_arena : { false, true }) {
+            std::unique_ptr<scene_arena> arena(use_arena ? new scene_arena() : nullptr);
+            hittable_list world;
+
+            double build;
+            long long allocations, bytes;
+            {
+                allocation_counter counter;
+                build = time_seconds([&] { world = random_sphere_scene(count, 1, arena.get()); });
+                allocations = counter.allocations;
+                bytes = counter.bytes;
+            }
+
+            double tree_build = time_seconds([&] { bvh tree(world); });
+            double release = time_seconds([&] {
+                world.clear();
+                arena.reset();
+            });
+
+            printf("%10d %8s %10.2f %12lld %10.1f %10.2f %10.2f\n", count, use_arena ? "arena" : "shared",
+                build * 1e3, allocations, bytes / 1048576.0, tree_build * 1e3, release * 1e3);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <bvh.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// N spheres scattered through a cube whose volume grows with N, so the
+// density (and the expected hit distance) stays roughly constant.
+static hittable_list random_spheres(int n, std::mt19937& rng) {
+    double half = std::cbrt(double(n));
+    std::uniform_real_distribution<double> position(-half, half);
+    std::uniform_real_distribution<double> radius(0.1, 0.3);
+
+    hittable_list world;
+    for (int i = 0; i < n; i++) {
+        world.add(make_shared<sphere>(point3(position(rng), position(rng), position(rng)), radius(rng)));
+    }
+    return world;
+}
+
+// Rays starting outside the cube and aimed at random points inside it.
+static std::vector<ray> random_rays(int n, int count, std::mt19937& rng) {
+    double half = std::cbrt(double(n));
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+    std::vector<ray> rays;
+    for (int i = 0; i < count; i++) {
+        point3 origin = 3 * half * unit_vector(vec3(unit(rng), unit(rng), unit(rng)));
+        point3 target = half * vec3(unit(rng), unit(rng), unit(rng));
+        rays.push_back(ray(origin, target - origin));
+    }
+    return rays;
+}
+
+void bench_bvh() {
+    printf("%10s %12s %14s %14s %10s %10s\n", "spheres", "build ms", "list Mray/s", "bvh Mray/s", "speedup", "mismatch");
+
+    for (int n : { 10, 1000, 100000, 1000000 }) {
+        std::mt19937 rng(1234);
+        hittable_list world = random_spheres(n, rng);
+        std::vector<ray> rays = random_rays(n, 4096, rng);
+
+        bvh* tree = nullptr;
+        double build = time_seconds([&] { tree = new bvh(world); });
+
+        size_t next = 0;
+        hit_record rec;
+        double list_seconds = seconds_per_call([&] {
+            world.hit(rays[next++ % rays.size()], 0.001, infinity, rec);
+        });
+        next = 0;
+        double bvh_seconds = seconds_per_call([&] {
+            tree->hit(rays[next++ % rays.size()], 0.001, infinity, rec);
+        });
+
+        // both must report the same nearest hit
+        int mismatches = 0;
+        for (int i = 0; i < 64; i++) {
+            hit_record a, b;
+            bool hit_a = world.hit(rays[i], 0.001, infinity, a);
+            bool hit_b = tree->hit(rays[i], 0.001, infinity, b);
+            if (hit_a != hit_b || (hit_a && a.t != b.t))
+                mismatches++;
+        }
+
+        printf("%10d %12.2f %14.3f %14.3f %9.1fx %10d\n", n, build * 1e3,
+            1e-6 / list_seconds, 1e-6 / bvh_seconds, list_seconds / bvh_seconds, mismatches);
+        delete tree;
+    }
+}
@@ -0,0 +1,72 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <camera.h>
+#include <path_tracer.h>
+#include <sampling.h>
+
+#include <cstdio>
+
+// The recursive ray_color the iterative path_tracer replaced, with the
+// same cosine-weighted bounces.
+static color recursive_ray_color(const ray& r, const hittable& world, int depth, path_stats& stats, int segments = 1) {
+    if (depth <= 0) {
+        stats.record(segments - 1);
+        return color(0, 0, 0);
+    }
+    hit_record rec;
+    if (world.hit(r, 0.001, infinity, rec)) {
+        double u = random_double();
+        double v = random_double();
+        return 0.5 * recursive_ray_color(ray(rec.p, sample_cosine_direction(rec.normal, u, v)), world, depth - 1, stats, segments + 1);
+    }
+    stats.record(segments);
+    return background(r);
+}
+
+// The diffuse two-sphere scene of the viewer, 128x128 at 16 spp, traced
+// recursively and with the iterative path_tracer with and without russian
+// roulette. The mean pixel value should agree within noise.
+void bench_integrator() {
+    const int width = 128;
+    const int height = 128;
+    const int spp = 16;
+
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5));
+    world.add(make_shared<sphere>(point3(0, -100.5, -1), 100));
+    camera cam;
+
+    printf("%-24s %10s %12s %12s %10s\n", "integrator", "max_depth", "Msample/s", "avg path", "mean");
+
+    auto run = [&](const char* name, int max_depth, bool recursive, int roulette_depth) {
+        path_stats stats;
+        path_tracer tracer(max_depth, roulette_depth, &stats);
+        color sum(0, 0, 0);
+        double seconds = time_seconds([&] {
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    for (int s = 0; s < spp; s++) {
+                        seed_pixel_rng(1, i + j * width, s);
+                        auto u = (i + random_double()) / (width - 1);
+                        auto v = (j + random_double()) / (height - 1);
+                        ray r = cam.get_ray(u, v);
+                        sum += recursive ? recursive_ray_color(r, world, max_depth, stats) : tracer.trace(r, world);
+                    }
+                }
+            }
+        });
+        double samples = double(width) * height * spp;
+        color mean = sum / samples;
+        printf("%-24s %10d %12.2f %12.3f %10.4f\n", name, max_depth, 1e-6 * samples / seconds,
+            stats.average_length(), (mean.x() + mean.y() + mean.z()) / 3);
+    };
+
+    for (int max_depth : { 10, 50 }) {
+        run("recursive", max_depth, true, 0);
+        run("iterative", max_depth, false, max_depth);
+        run("iterative + roulette", max_depth, false, 3);
+    }
+}
@@ -0,0 +1,134 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <color.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <camera.h>
+#include <accumulation_buffer.h>
+#include <path_tracer.h>
+#include <sampling.h>
+#include <scenes.h>
+#include <trace.h>
+
+#include <cstdint>
+#include <vector>
+
+// Per-call cost of the building blocks of a render. Every benchmark cycles
+// through a fixed, seeded set of inputs, so runs are comparable; each figure
+// is the median of five runs.
+void bench_kernels() {
+    const int input_count = 4096;
+    const int image_size = 64;
+
+    // camera rays over a 64x64 image of the two-sphere scene; about half hit
+    camera cam;
+    hittable_list world = two_sphere_scene();
+    hittable_list crowd = random_sphere_scene(100);
+    pcg32 rng(42, 0);
+    std::vector<ray> rays;
+    std::vector<double> us, vs;
+    for (int n = 0; n < input_count; n++) {
+        double u = (n % image_size + rng.next_double()) / (image_size - 1);
+        double v = (n / image_size % image_size + rng.next_double()) / (image_size - 1);
+        us.push_back(u);
+        vs.push_back(v);
+        rays.push_back(cam.get_ray(u, v));
+    }
+
+    sphere ball(point3(0, 0, -1), 0.5);
+    int k = 0;
+    auto next = [&k] { k = (k + 1) & (input_count - 1); return k; };
+
+    auto record_rays = [](const char* name, double seconds, double rays_per_op) {
+        record_result(name, seconds * 1e9, rays_per_op / seconds);
+    };
+
+    record_rays("sphere::hit", median_seconds_per_call([&] {
+        hit_record rec;
+        do_not_optimize(ball.hit(rays[next()], 0.001, infinity, rec));
+        do_not_optimize(rec.t);
+    }), 1);
+
+    record_rays("hittable_list::hit (2 spheres)", median_seconds_per_call([&] {
+        hit_record rec;
+        do_not_optimize(world.hit(rays[next()], 0.001, infinity, rec));
+        do_not_optimize(rec.t);
+    }), 1);
+
+    record_rays("hittable_list::hit (101 spheres)", median_seconds_per_call([&] {
+        hit_record rec;
+        do_not_optimize(crowd.hit(rays[next()], 0.001, infinity, rec));
+        do_not_optimize(rec.t);
+    }), 1);
+
+    record_result("camera::get_ray", 1e9 * median_seconds_per_call([&] {
+        int n = next();
+        do_not_optimize(cam.get_ray(us[n], vs[n]));
+    }));
+
+    record_result("random_in_unit_sphere", 1e9 * median_seconds_per_call([&] {
+        do_not_optimize(random_in_unit_sphere());
+    }));
+
+    record_result("sample_cosine_direction", 1e9 * median_seconds_per_call([&] {
+        int n = next();
+        do_not_optimize(sample_cosine_direction(vec3(0, 1, 0), us[n], vs[n]));
+    }));
+
+    record_result("unit_vector", 1e9 * median_seconds_per_call([&] {
+        do_not_optimize(unit_vector(rays[next()].direction()));
+    }));
+
+    // rays per second counts every segment of the paths, not just camera rays
+    for (bool roulette : { false, true }) {
+        path_stats stats;
+        path_tracer tracer(50, roulette ? 3 : 50, &stats);
+        double seconds = median_seconds_per_call([&] {
+            int n = next();
+            seed_pixel_rng(1, n, 0);
+            do_not_optimize(tracer.trace(rays[n], world));
+        });
+        record_rays(roulette ? "ray_color (path_tracer, roulette)" : "ray_color (path_tracer)", seconds, stats.average_length());
+    }
+
+    // fillPixels in the viewer is write_rgba on its display buffer
+    std::vector<uint8_t> rgba(size_t(input_count) * 4);
+    std::vector<color> colors;
+    for (int n = 0; n < input_count; n++) {
+        colors.push_back(color(rng.next_double(), rng.next_double(), rng.next_double()));
+    }
+    record_result("fillPixels (write_rgba, gamma)", 1e9 * median_seconds_per_call([&] {
+        int n = next();
+        write_rgba(rgba.data(), n, colors[n], 1.0 / 16, true);
+        do_not_optimize(rgba[n * 4]);
+    }));
+
+    accumulation_buffer accum;
+    accum.resize(image_size, image_size);
+    for (int n = 0; n < input_count; n++) {
+        accum.add_sample(n, colors[n]);
+    }
+    record_result("accumulation_buffer::resolve_pixel", 1e9 * median_seconds_per_call([&] {
+        int n = next();
+        accum.resolve_pixel(n, rgba.data(), true);
+        do_not_optimize(rgba[n * 4]);
+    }));
+
+    // a zone around nothing: what RT_TRACE_ZONE adds to the scope it marks
+    record_result("trace zone (tracing off)", 1e9 * median_seconds_per_call([&] {
+        RT_TRACE_ZONE("bench");
+        do_not_optimize(next());
+    }));
+    // fewer zones than a thread's buffer holds, so none is dropped
+    const int zone_count = 100000;
+    trace_log::global().start();
+    double on_seconds = time_seconds([&] {
+        for (int n = 0; n < zone_count; n++) {
+            RT_TRACE_ZONE("bench");
+            do_not_optimize(next());
+        }
+    });
+    trace_log::global().stop();
+    record_result("trace zone (tracing on)", 1e9 * on_seconds / zone_count);
+}
@@ -0,0 +1,211 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <camera.h>
+#include <bvh.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <progressive_renderer.h>
+#include <path_tracer.h>
+#include <render_stats.h>
+#include <space_filling.h>
+#include <scenes.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware cache misses of this process, threads started after open()
+// included (read them once those threads have exited). Linux only, and
+// only where the kernel exposes the counters: VMs and containers often do
+// not, then count() stays -1.
+class cache_miss_counter
+{
+public:
+    ~cache_miss_counter() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    bool open() {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        return fd >= 0;
+#else
+        return false;
+#endif
+    }
+
+    long long count() const {
+#ifdef __linux__
+        long long value;
+        if (fd >= 0 && read(fd, &value, sizeof(value)) == sizeof(value))
+            return value;
+#endif
+        return -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+// A set-associative LRU cache, for counting the misses an access pattern
+// causes independently of the machine: 32 KB, 64-byte lines, 8 ways.
+class cache_model
+{
+public:
+    cache_model() : tags(sets * ways, ~uint64_t(0)) {}
+
+    void access(uint64_t address) {
+        uint64_t line = address / line_size;
+        uint64_t* set = &tags[(line % sets) * ways];
+        for (int w = 0; w < ways; w++) {
+            if (set[w] == line) {
+                // move to the front: most recently used first
+                for (int k = w; k > 0; k--) {
+                    set[k] = set[k - 1];
+                }
+                set[0] = line;
+                return;
+            }
+        }
+        misses++;
+        for (int k = ways - 1; k > 0; k--) {
+            set[k] = set[k - 1];
+        }
+        set[0] = line;
+    }
+
+public:
+    long long misses = 0;
+
+private:
+    static const int line_size = 64;
+    static const int ways = 8;
+    static const int sets = 32 * 1024 / (line_size * ways);
+    std::vector<uint64_t> tags;
+};
+
+// Framebuffer misses of one pass in the cache model: the accumulation
+// buffer's sums and count (in its layout) and the RGBA8 display pixel, for
+// every pixel in the engine's visiting order.
+static long long framebuffer_misses(pixel_order order, int width, int height, int tile_size) {
+    accumulation_buffer accum;
+    accum.set_layout(order, tile_size);
+    accum.resize(width, height);
+    const uint64_t radiance = 1ull << 32, squares = 2ull << 32, counts = 3ull << 32, display = 4ull << 32;
+
+    cache_model cache;
+    auto visit = [&](int i, int j) {
+        int index = i + j * width;
+        uint64_t slot = accum.slot(index);
+        cache.access(counts + slot * 4);
+        cache.access(radiance + slot * 12);
+        cache.access(radiance + slot * 12 + 11);
+        cache.access(squares + slot * 4);
+        cache.access(display + uint64_t(index) * 4);
+    };
+    uint32_t side = next_power_of_two(uint32_t(tile_size));
+    std::vector<curve_cell> cells = curve_cells(order, side);
+    for (const tile& t : make_tiles(width, height, tile_size, order)) {
+        if (order == pixel_order::row_major) {
+            for (int j = t.y0; j < t.y1; j++) {
+                for (int i = t.x0; i < t.x1; i++) {
+                    visit(i, j);
+                }
+            }
+            continue;
+        }
+        for (const curve_cell& c : cells) {
+            if (t.x0 + c.x < t.x1 && t.y0 + c.y < t.y1)
+                visit(t.x0 + c.x, t.y0 + c.y);
+        }
+    }
+    return cache.misses;
+}
+
+// Row-major against Morton and Hilbert order (tiles, pixels in a tile and
+// the accumulation buffer's layout) on a 100k-sphere bvh: normals (primary
+// rays only, where neighbouring rays are most alike) and the path tracer.
+// Rays/s come from render_stats; the images are identical in every order.
+void bench_order() {
+    const int width = 1280;
+    const int height = 720;
+    const int passes = 2;
+    hittable_list world = random_sphere_scene(100000);
+    bvh tree(world);
+    camera cam;
+    path_tracer tracer(50, 3);
+
+    bool have_counter = false;
+    {
+        cache_miss_counter probe;
+        have_counter = probe.open();
+    }
+    if (!have_counter)
+        printf("(no hardware cache counters here, only the cache model)\n");
+
+    // rays/s are recorded as they are measured, the cache figures printed after
+    std::vector<std::string> cache_rows;
+    const pixel_order orders[] = { pixel_order::row_major, pixel_order::morton, pixel_order::hilbert };
+    for (int shading = 0; shading < 2; shading++) {
+        for (pixel_order order : orders) {
+            cache_miss_counter counter;
+            counter.open();
+            render_stats::global().reset();
+            {
+                render_engine engine(1);
+                engine.order = order;
+                accumulation_buffer accum;
+                accum.set_layout(order, engine.tile_size);
+                accum.resize(width, height);
+                progressive_renderer renderer(engine, accum);
+                renderer.target_passes = passes;
+                renderer.accumulate([&](int i, int j) {
+                    auto u = real((i + random_double2()) / (width - 1));
+                    auto v = real((j + random_double2()) / (height - 1));
+                    ray r = cam.get_ray(u, v);
+                    return shading == 0 ? normal_color(r, tree) : tracer.trace(r, tree);
+                });
+            }
+            long long misses = counter.count();
+            render_stats::snapshot stats = render_stats::global().read();
+            std::string name = std::string(shading == 0 ? "normals" : "path") + ", " + pixel_order_name(order);
+            record_result(name, 1e9 * stats.pass_seconds / (double(width) * height * passes), stats.rays_per_second());
+            char hw[32] = "n/a";
+            if (misses >= 0)
+                snprintf(hw, sizeof(hw), "%.3f", double(misses) / stats.totals.rays);
+            char row[128];
+            snprintf(row, sizeof(row), "%-16s %14s %16lld", name.c_str(), hw, framebuffer_misses(order, width, height, 32) * passes);
+            cache_rows.push_back(row);
+        }
+    }
+
+    printf("%-16s %14s %16s\n", "", "HW misses/ray", "model fb misses");
+    for (const std::string& row : cache_rows) {
+        printf("%s\n", row.c_str());
+    }
+}
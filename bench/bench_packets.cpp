@@ -0,0 +1,80 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <camera.h>
+#include <bvh.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+// Primary rays of a 512x512 image through a bvh, traced one by one and as
+// square pixel packets.
+void bench_packets() {
+    const int width = 512;
+    const int height = 512;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    std::uniform_real_distribution<double> depth(-30.0, -5.0);
+
+    printf("%10s %14s %14s %14s %10s\n", "spheres", "single Mray/s", "4x4 Mray/s", "8x8 Mray/s", "mismatch");
+
+    for (int n : { 1000, 100000 }) {
+        // spheres inside the view frustum, sized so the far ones still cover a few pixels
+        hittable_list world;
+        for (int i = 0; i < n; i++) {
+            double z = depth(rng);
+            world.add(make_shared<sphere>(point3(-z * unit(rng), -z * unit(rng), z), 0.1 * std::cbrt(1e5 / n)));
+        }
+        bvh tree(world);
+        camera cam;
+
+        auto trace_single = [&] {
+            hit_record rec;
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    tree.hit(cam.get_ray(double(i) / (width - 1), double(j) / (height - 1)), 0.001, infinity, rec);
+                }
+            }
+        };
+        auto trace_packets = [&](int block) {
+            for (int by = 0; by < height; by += block) {
+                for (int bx = 0; bx < width; bx += block) {
+                    ray_packet packet;
+                    for (int j = by; j < std::min(by + block, height); j++) {
+                        for (int i = bx; i < std::min(bx + block, width); i++) {
+                            packet.add(cam.get_ray(double(i) / (width - 1), double(j) / (height - 1)));
+                        }
+                    }
+                    tree.hit_packet(packet, 0.001);
+                }
+            }
+        };
+
+        double rays = double(width) * height;
+        double single = seconds_per_call(trace_single, 1.0);
+        double packet4 = seconds_per_call([&] { trace_packets(4); }, 1.0);
+        double packet8 = seconds_per_call([&] { trace_packets(8); }, 1.0);
+
+        // the packet path must find exactly the single-ray hits
+        int mismatches = 0;
+        for (int j = 0; j < height; j += 8) {
+            ray_packet packet;
+            for (int i = 0; i < 8; i++) {
+                packet.add(cam.get_ray(double(i) / (width - 1), double(j) / (height - 1)));
+            }
+            tree.hit_packet(packet, 0.001);
+            for (int k = 0; k < packet.size; k++) {
+                hit_record rec;
+                bool hit = tree.hit(packet.get(k), 0.001, infinity, rec);
+                if (hit != packet.hit[k] || (hit && rec.t != packet.rec[k].t))
+                    mismatches++;
+            }
+        }
+
+        printf("%10d %14.3f %14.3f %14.3f %10d\n", n, rays * 1e-6 / single, rays * 1e-6 / packet4, rays * 1e-6 / packet8, mismatches);
+    }
+}
@@ -0,0 +1,86 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <vec3.h>
+#include <sampling.h>
+#include <thread_pool.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+// The generators random_double() and random_double2() used before pcg32.
+static double old_random_double() {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static double old_random_double2() {
+    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    static std::mt19937 generator;
+    return distribution(generator);
+}
+
+static vec3 old_random_in_unit_sphere() {
+    while (true) {
+        auto p = vec3(-1 + 2 * old_random_double(), -1 + 2 * old_random_double(), -1 + 2 * old_random_double());
+        if (p.length_squared() >= 1) continue;
+        return p;
+    }
+}
+
+// Keeps results alive so the calls are not optimized away.
+static volatile double sink;
+
+template<typename F>
+static void report(const char* name, F f) {
+    double seconds = seconds_per_call(f, 0.3);
+    printf("%-34s %10.2f ns/call\n", name, seconds * 1e9);
+}
+
+// Calls per second summed over `threads` threads each making `calls` calls.
+template<typename F>
+static double parallel_rate(int threads, long long calls, F f) {
+    double seconds = time_seconds([&] {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&] {
+                double sum = 0;
+                for (long long n = 0; n < calls; n++) {
+                    sum += f();
+                }
+                sink = sum;
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+    });
+    return threads * calls / seconds;
+}
+
+void bench_rng() {
+    pcg32 local;
+    report("rand()", [] { sink = old_random_double(); });
+    report("mt19937 + uniform_real_distribution", [] { sink = old_random_double2(); });
+    report("pcg32::next_double", [&] { sink = local.next_double(); });
+    report("random_double (thread-local pcg32)", [] { sink = random_double(); });
+    report("seed_pixel_rng", [] { seed_pixel_rng(1, 12345, 7); });
+    report("random_in_unit_sphere, rand()", [] { sink = old_random_in_unit_sphere().x(); });
+    report("random_in_unit_sphere, pcg32", [] { sink = random_in_unit_sphere().x(); });
+
+    // the closed-form warps, from two pcg32 numbers each
+    report("sample_uniform_sphere", [] { sink = sample_uniform_sphere(random_double(), random_double()).x(); });
+    report("sample_uniform_disk", [] { sink = sample_uniform_disk(random_double(), random_double()).x(); });
+    report("sample_concentric_disk", [] { sink = sample_concentric_disk(random_double(), random_double()).x(); });
+    report("sample_cosine_hemisphere", [] { sink = sample_cosine_hemisphere(random_double(), random_double()).x(); });
+    report("sample_cosine_direction", [] { sink = sample_cosine_direction(vec3(0, 1, 0), random_double(), random_double()).x(); });
+
+    // rand() shares one locked state in glibc; the thread-local pcg32 does not
+    int threads = thread_pool::default_thread_count();
+    long long calls = 10000000;
+    printf("%d threads, %lld calls each:\n", threads, calls);
+    printf("%-34s %10.1f Mcall/s\n", "rand()", 1e-6 * parallel_rate(threads, calls, old_random_double));
+    printf("%-34s %10.1f Mcall/s\n", "random_double (thread-local pcg32)", 1e-6 * parallel_rate(threads, calls, [] { return random_double(); }));
+}
@@ -0,0 +1,101 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <camera.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <progressive_renderer.h>
+#include <path_tracer.h>
+#include <render_stats.h>
+#include <sampler.h>
+#include <scenes.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Mean radiance per pixel (3 floats each) of a render of the diffuse
+// two-sphere scene with the given sampler, and its rays/s.
+static std::vector<double> render_means(sampler_type sampler, int width, int height, int spp, int seed, double& seconds,
+    double& rays_per_second) {
+    hittable_list world = two_sphere_scene();
+    camera cam;
+    path_tracer tracer(50);
+
+    render_engine engine;
+    accumulation_buffer accum;
+    accum.resize(width, height);
+    progressive_renderer renderer(engine, accum);
+    renderer.target_passes = spp;
+    renderer.seed = seed;
+    renderer.sampler = sampler;
+    render_stats::global().reset();
+    seconds = time_seconds([&] {
+        renderer.accumulate([&](int i, int j) {
+            double du, dv;
+            sample_2d(du, dv);
+            auto u = real((i + du) / (width - 1));
+            auto v = real((j + dv) / (height - 1));
+            return tracer.trace(cam.get_ray(u, v), world);
+        });
+    });
+    rays_per_second = render_stats::global().read().rays_per_second();
+
+    std::vector<double> means(size_t(width) * height * 3);
+    for (int index = 0; index < width * height; index++) {
+        pixel_sum s = accum.sum(index);
+        for (int c = 0; c < 3; c++) {
+            means[size_t(index) * 3 + c] = double(s.radiance[c]) / s.count;
+        }
+    }
+    return means;
+}
+
+static double rmse(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0;
+    for (size_t k = 0; k < a.size(); k++) {
+        sum += (a[k] - b[k]) * (a[k] - b[k]);
+    }
+    return std::sqrt(sum / a.size());
+}
+
+// Convergence of each sampler on the diffuse two-sphere scene: RMSE of the
+// linear radiance against a 4096 spp independent reference, at 1 to 256
+// spp, and how many independent samples the same error takes (by the
+// 1/sqrt(N) law). Blue noise is judged by the same per-pixel RMSE, which
+// does not credit how it spreads the error over the image.
+void bench_samplers() {
+    const int width = 64;
+    const int height = 64;
+    double seconds, rays_per_second;
+    blue_noise_mask();  // built on first use, not part of any timing
+    std::vector<double> reference = render_means(sampler_type::independent, width, height, 4096, 1234, seconds, rays_per_second);
+    printf("reference: 4096 spp independent, %dx%d, %.1f s\n", width, height, seconds);
+
+    // the cost of each render is recorded as it is measured, the errors printed after
+    const sampler_type samplers[] = { sampler_type::independent, sampler_type::stratified, sampler_type::sobol, sampler_type::blue_noise };
+    const int counts[] = { 1, 4, 16, 64, 256 };
+    std::vector<std::string> error_rows;
+    std::vector<double> independent_rmse;
+    for (sampler_type sampler : samplers) {
+        for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+            int spp = counts[k];
+            double error = rmse(render_means(sampler, width, height, spp, 1, seconds, rays_per_second), reference);
+            record_result(std::string(sampler_name(sampler)) + ", " + std::to_string(spp) + " spp",
+                1e9 * seconds / (double(width) * height * spp), rays_per_second);
+            if (sampler == sampler_type::independent)
+                independent_rmse.push_back(error);
+            double ratio = independent_rmse[k] / error;
+            char row[128];
+            snprintf(row, sizeof(row), "%-12s %6d %12.5f %14.1f", sampler_name(sampler), spp, error, spp * ratio * ratio);
+            error_rows.push_back(row);
+        }
+    }
+
+    printf("%-12s %6s %12s %14s\n", "sampler", "spp", "rmse", "indep. spp");
+    for (const std::string& row : error_rows) {
+        printf("%s\n", row.c_str());
+    }
+}
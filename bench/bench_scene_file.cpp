@@ -0,0 +1,63 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <scene_arena.h>
+#include <scene_file.h>
+#include <scenes.h>
+
+#include <cstdio>
+#include <string>
+
+// Loading a million-sphere scene file: parsing the text, writing the binary
+// cache, mapping the cache (every sphere read once, so the pages are really
+// in) and turning the spheres into a hittable_list, all in milliseconds.
+// Uses scratch files in the working directory.
+void bench_scene_file() {
+    const int count = 1000000;
+    const std::string text_path = "bench-scene.tmp";
+    const std::string cache_path = text_path + ".cache";
+
+    {
+        scene_file source;
+        source.add(random_sphere_scene(count));
+        if (!source.write_text(text_path)) {
+            printf("cannot write %s\n", text_path.c_str());
+            return;
+        }
+    }
+    uint64_t size = 0;
+    int64_t modified = 0;
+    if (!file_stamp(text_path, size, modified)) {
+        printf("cannot stat %s\n", text_path.c_str());
+        std::remove(text_path.c_str());
+        return;
+    }
+
+    scene_file file;
+    std::string error;
+    double parse = time_seconds([&] { file.read_text(text_path, error); });
+    double write = time_seconds([&] { file.write_cache(cache_path, size, modified); });
+
+    scene_file mapped;
+    double radii = 0;
+    double map = time_seconds([&] {
+        mapped.map_cache(cache_path, size, modified);
+        for (size_t k = 0; k < mapped.sphere_count(); k++) {
+            radii += mapped.spheres()[k].radius;
+        }
+    });
+    do_not_optimize(radii);
+
+    scene_arena arena;
+    hittable_list world;
+    double make = time_seconds([&] { world = mapped.make_world(&arena); });
+
+    printf("%10s %12s %12s %12s %14s\n", "spheres", "text MB", "parse ms", "cache ms", "map+read ms");
+    printf("%10zu %12.1f %12.2f %12.2f %14.2f\n", mapped.sphere_count(), size / 1048576.0, parse * 1e3, write * 1e3, map * 1e3);
+    printf("hittable_list from the mapping (arena): %.2f ms\n", make * 1e3);
+
+    world.clear();
+    mapped.clear();
+    std::remove(text_path.c_str());
+    std::remove(cache_path.c_str());
+}
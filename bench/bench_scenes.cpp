@@ -0,0 +1,53 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <camera.h>
+#include <bvh.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <path_tracer.h>
+#include <progressive_renderer.h>
+#include <scenes.h>
+
+#include <string>
+
+// End-to-end progressive renders on every core: the two-sphere scene of
+// outPutRayColorRandomNormalSphere and generated sphere fields through a
+// bvh. ns/op is per sample; rays per second counts every path segment.
+void bench_scenes() {
+    const int width = 256;
+    const int height = 256;
+    const int spp = 8;
+
+    render_engine engine;
+    camera cam;
+
+    auto run = [&](const std::string& name, const hittable& world) {
+        accumulation_buffer accum;
+        path_stats stats;
+        path_tracer tracer(50, 3, &stats);
+        double seconds = median_seconds_per_call([&] {
+            accum.resize(width, height);
+            progressive_renderer renderer(engine, accum);
+            renderer.target_passes = spp;
+            renderer.seed = 1;
+            renderer.accumulate([&](int i, int j) {
+                auto u = (i + random_double2()) / (width - 1);
+                auto v = (j + random_double2()) / (height - 1);
+                return tracer.trace(cam.get_ray(u, v), world);
+            });
+        }, 3, 0.5);
+        double samples = double(width) * height * spp;
+        record_result(name, seconds * 1e9 / samples, samples * stats.average_length() / seconds);
+    };
+
+    hittable_list two_spheres = two_sphere_scene();
+    run("two spheres, list", two_spheres);
+
+    for (int count : { 1000, 100000 }) {
+        hittable_list world = random_sphere_scene(count);
+        bvh tree(world);
+        run(std::to_string(count) + " spheres, bvh", tree);
+    }
+}
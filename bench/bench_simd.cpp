@@ -0,0 +1,114 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <sphere_set.h>
+#include <compiled_scene.h>
+#include <bvh.h>
+#include <cpu_features.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Flat sphere scenes: the linear hittable_list against its compiled_scene
+// and every sphere_set kernel the CPU supports, then a large scene through
+// bvh with and without sphere_set leaves.
+void bench_simd() {
+    printf("cpu simd level: %s\n", simd_level_name(cpu_simd_level()));
+    printf("%10s %14s %14s", "spheres", "list Mray/s", "compiled");
+    for (int level = 0; level <= int(cpu_simd_level()); level++) {
+        printf(" %14s", simd_level_name(simd_level(level)));
+    }
+    printf(" %10s\n", "mismatch");
+
+    for (int n : { 4, 16, 64, 256, 1024 }) {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> unit(-1.0, 1.0);
+        std::uniform_real_distribution<double> radius(0.05, 0.2);
+
+        hittable_list world;
+        sphere_set packed;
+        for (int i = 0; i < n; i++) {
+            point3 center(2 * unit(rng), 2 * unit(rng), 2 * unit(rng));
+            double r = radius(rng);
+            world.add(make_shared<sphere>(center, r));
+            packed.add(center, r);
+        }
+
+        std::vector<ray> rays;
+        for (int i = 0; i < 1024; i++) {
+            point3 origin(unit(rng), unit(rng), 5);
+            rays.push_back(ray(origin, vec3(unit(rng), unit(rng), unit(rng) - 5) - origin));
+        }
+
+        size_t next = 0;
+        hit_record rec;
+        double list_seconds = seconds_per_call([&] {
+            world.hit(rays[next++ % rays.size()], 0.001, infinity, rec);
+        });
+        compiled_scene compiled(world);
+        next = 0;
+        double compiled_seconds = seconds_per_call([&] {
+            compiled.hit(rays[next++ % rays.size()], 0.001, infinity, rec);
+        });
+        printf("%10d %14.3f %14.3f", n, 1e-6 / list_seconds, 1e-6 / compiled_seconds);
+
+        int mismatches = 0;
+        for (const ray& r : rays) {
+            hit_record a, b;
+            bool hit_a = world.hit(r, 0.001, infinity, a);
+            bool hit_b = compiled.hit(r, 0.001, infinity, b);
+            if (hit_a != hit_b || (hit_a && a.t != b.t))
+                mismatches++;
+        }
+        for (int level = 0; level <= int(cpu_simd_level()); level++) {
+            simd_level kernel = simd_level(level);
+            next = 0;
+            double seconds = seconds_per_call([&] {
+                packed.hit(kernel, rays[next++ % rays.size()], 0.001, infinity, rec);
+            });
+            printf(" %14.3f", 1e-6 / seconds);
+
+            for (const ray& r : rays) {
+                hit_record a, b;
+                bool hit_a = world.hit(r, 0.001, infinity, a);
+                bool hit_b = packed.hit(kernel, r, 0.001, infinity, b);
+                if (hit_a != hit_b || (hit_a && a.t != b.t))
+                    mismatches++;
+            }
+        }
+        printf(" %10d\n", mismatches);
+    }
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> position(-50, 50);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    hittable_list world;
+    for (int i = 0; i < 100000; i++) {
+        world.add(make_shared<sphere>(point3(position(rng), position(rng), position(rng)), 0.3));
+    }
+    std::vector<ray> rays;
+    for (int i = 0; i < 4096; i++) {
+        point3 origin = 150 * unit_vector(vec3(unit(rng), unit(rng), unit(rng)));
+        rays.push_back(ray(origin, vec3(position(rng), position(rng), position(rng)) - origin));
+    }
+
+    printf("%10s %14s %14s\n", "bvh leaves", "build ms", "Mray/s");
+    for (bool pack : { false, true }) {
+        for (int leaf_size : { 4, 8 }) {
+            bvh* tree = nullptr;
+            double build = time_seconds([&] { tree = new bvh(world, leaf_size, pack); });
+            size_t next = 0;
+            hit_record rec;
+            double seconds = seconds_per_call([&] {
+                tree->hit(rays[next++ % rays.size()], 0.001, infinity, rec);
+            });
+            char label[32];
+            snprintf(label, sizeof(label), "%s x%d", pack ? "packed" : "single", leaf_size);
+            printf("%10s %14.2f %14.3f\n", label, build * 1e3, 1e-6 / seconds);
+            delete tree;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#include "benchmark.h"
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <camera.h>
+#include <bvh.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <progressive_renderer.h>
+#include <path_tracer.h>
+#include <wavefront.h>
+#include <render_stats.h>
+#include <scenes.h>
+
+#include <cstdio>
+#include <string>
+
+// Path by path (accumulate), primary packets (accumulate_packets) and
+// wavefront batches of one tile (accumulate_wavefront) at several tile
+// sizes, with and without sorting the bounce rays, on the two-sphere
+// scene, where most rays are bounces, and on 100k and 1M sphere bvhs.
+// Rays/s come from render_stats; path and wavefront, sorted or not,
+// produce the same image.
+void bench_wavefront() {
+    const int width = 640;
+    const int height = 360;
+    const int passes = 4;
+    const int max_depth = 50;
+
+    bvh small(two_sphere_scene());
+    hittable_list many = random_sphere_scene(100000);
+    bvh large(many);
+    hittable_list most = random_sphere_scene(1000000);
+    bvh huge(most);
+    camera cam;
+
+    struct scene_case {
+        const char* name;
+        const hittable* world;
+    };
+    const scene_case scenes[] = { { "2 spheres", &small }, { "100k spheres", &large }, { "1M spheres", &huge } };
+
+    struct integrator_case {
+        const char* name;
+        int kind;               // 0 path, 1 packets, 2 wavefront
+        int tile_size;
+        bool reorder;
+    };
+    const integrator_case integrators[] = {
+        { "path", 0, 32, false },
+        { "packets", 1, 32, false },
+        { "wavefront 32", 2, 32, false },
+        { "wavefront 32 sorted", 2, 32, true },
+        { "wavefront 64", 2, 64, false },
+        { "wavefront 128", 2, 128, false },
+        { "wavefront 128 sorted", 2, 128, true },
+    };
+
+    for (const scene_case& sc : scenes) {
+        double rays_per_path = 0;
+        for (const integrator_case& ic : integrators) {
+            render_stats::global().reset();
+            {
+                render_engine engine(1);
+                engine.tile_size = ic.tile_size;
+                accumulation_buffer accum;
+                accum.resize(width, height);
+                progressive_renderer renderer(engine, accum);
+                renderer.target_passes = passes;
+                path_tracer tracer(max_depth);
+                const hittable& world = *sc.world;
+                if (ic.kind == 0) {
+                    renderer.accumulate([&](int i, int j) {
+                        auto u = real((i + random_double2()) / (width - 1));
+                        auto v = real((j + random_double2()) / (height - 1));
+                        return tracer.trace(cam.get_ray(u, v), world);
+                    });
+                }
+                else if (ic.kind == 1) {
+                    renderer.accumulate_packets(cam, world, [&](const ray& r, bool hit, const hit_record& rec) {
+                        return tracer.trace_from_hit(r, hit, rec, world);
+                    });
+                }
+                else {
+                    wavefront_tracer wavefront(max_depth);
+                    wavefront.reorder = ic.reorder;
+                    renderer.accumulate_wavefront(cam, world, wavefront);
+                }
+            }
+            render_stats::snapshot stats = render_stats::global().read();
+            record_result(std::string(sc.name) + ", " + ic.name, 1e9 * stats.pass_seconds / (double(width) * height * passes),
+                stats.rays_per_second());
+            rays_per_path = double(stats.totals.rays) / double(stats.totals.paths);
+        }
+        printf("%s: %.3f rays/path with every integrator\n", sc.name, rays_per_path);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Wall-clock seconds spent in f().
+template<typename F>
+double time_seconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Calls f() in growing batches until at least min_seconds have passed and
+// returns the mean seconds per call. f() should do one unit of work.
+template<typename F>
+double seconds_per_call(F f, double min_seconds = 0.5) {
+    long long calls = 0;
+    long long batch = 1;
+    double total = 0;
+    while (total < min_seconds) {
+        total += time_seconds([&] {
+            for (long long n = 0; n < batch; n++) {
+                f();
+            }
+        });
+        calls += batch;
+        batch *= 2;
+    }
+    return total / calls;
+}
+
+// Median of `repeats` seconds_per_call() runs; steadier than one long run
+// when the machine is not quiet.
+template<typename F>
+double median_seconds_per_call(F f, int repeats = 5, double min_seconds = 0.1) {
+    f();  // warm caches and lazy initialization
+    std::vector<double> runs;
+    for (int r = 0; r < repeats; r++) {
+        runs.push_back(seconds_per_call(f, min_seconds));
+    }
+    std::sort(runs.begin(), runs.end());
+    return runs[runs.size() / 2];
+}
+
+// Keeps a value the optimizer would otherwise drop as unused.
+template<typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// One measurement, printed as it is recorded and written to the JSON report
+// when the bench runs with --json FILE. rays_per_second is 0 where it does
+// not apply.
+struct bench_result {
+    std::string suite;
+    std::string name;
+    double ns_per_op;
+    double rays_per_second;
+};
+
+void record_result(const std::string& name, double ns_per_op, double rays_per_second = 0);
+
+// Benchmark suites, selected by name on the command line.
+void bench_bvh();
+void bench_simd();
+void bench_packets();
+void bench_rng();
+void bench_integrator();
+void bench_kernels();
+void bench_scenes();
+void bench_arena();
+void bench_scene_file();
+void bench_order();
+void bench_wavefront();
+void bench_samplers();
+
+#endif
@@ -0,0 +1,100 @@
+#include "benchmark.h"
+
+#include <cpu_features.h>
+#include <thread_pool.h>
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+struct suite {
+    const char* name;
+    void (*run)();
+};
+
+const suite suites[] = {
+    { "bvh", bench_bvh },
+    { "simd", bench_simd },
+    { "packets", bench_packets },
+    { "rng", bench_rng },
+    { "integrator", bench_integrator },
+    { "kernels", bench_kernels },
+    { "scenes", bench_scenes },
+    { "arena", bench_arena },
+    { "scenefile", bench_scene_file },
+    { "order", bench_order },
+    { "wavefront", bench_wavefront },
+    { "samplers", bench_samplers },
+};
+
+static std::string current_suite;
+static std::vector<bench_result> results;
+
+void record_result(const std::string& name, double ns_per_op, double rays_per_second) {
+    results.push_back({ current_suite, name, ns_per_op, rays_per_second });
+    if (rays_per_second > 0)
+        printf("%-40s %12.2f ns/op %12.3f Mray/s\n", name.c_str(), ns_per_op, rays_per_second * 1e-6);
+    else
+        printf("%-40s %12.2f ns/op\n", name.c_str(), ns_per_op);
+}
+
+static std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static bool write_json(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "{\n  \"timestamp\": %lld,\n", static_cast<long long>(time(nullptr)));
+    fprintf(file, "  \"simd\": \"%s\",\n", simd_level_name(cpu_simd_level()));
+    fprintf(file, "  \"threads\": %d,\n", thread_pool::default_thread_count());
+    fprintf(file, "  \"results\": [\n");
+    for (size_t k = 0; k < results.size(); k++) {
+        const bench_result& r = results[k];
+        fprintf(file, "    { \"suite\": \"%s\", \"name\": \"%s\", \"ns_per_op\": %.4f, \"rays_per_second\": %.1f }%s\n",
+            json_escape(r.suite).c_str(), json_escape(r.name).c_str(), r.ns_per_op, r.rays_per_second,
+            k + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+// Usage: raytracer-bench [--json FILE] [suite...]   (no suites runs every suite)
+// Only suites that record their results (kernels, scenes, order, wavefront, samplers) appear in the JSON.
+int main(int argc, char** argv) {
+    const char* json_path = nullptr;
+    std::vector<const char*> selected_names;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc)
+            json_path = argv[++a];
+        else
+            selected_names.push_back(argv[a]);
+    }
+
+    for (const suite& s : suites) {
+        bool selected = selected_names.empty();
+        for (const char* name : selected_names) {
+            if (strcmp(name, s.name) == 0)
+                selected = true;
+        }
+        if (!selected)
+            continue;
+
+        printf("== %s\n", s.name);
+        current_suite = s.name;
+        s.run();
+    }
+
+    if (json_path != nullptr && !write_json(json_path)) {
+        fprintf(stderr, "cannot write %s\n", json_path);
+        return 1;
+    }
+    return 0;
+}
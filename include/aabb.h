@@ -0,0 +1,81 @@
+#pragma once
+#ifndef AABB_H
+#define AABB_H
+
+#include <rtweekend.h>
+
+#include <algorithm>
+
+// Axis-aligned bounding box.
+class aabb
+{
+public:
+	aabb() : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity) {}
+	aabb(const point3& a, const point3& b) : minimum(a), maximum(b) {}
+
+	point3 min() const { return minimum; }
+	point3 max() const { return maximum; }
+
+	point3 centroid() const {
+		return 0.5 * (minimum + maximum);
+	}
+
+	int longest_axis() const {
+		vec3 extent = maximum - minimum;
+		if (extent.x() > extent.y() && extent.x() > extent.z())
+			return 0;
+		return extent.y() > extent.z() ? 1 : 2;
+	}
+
+	real surface_area() const {
+		vec3 d = maximum - minimum;
+		return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	}
+
+	void expand(const point3& p) {
+		expand(p, p);
+	}
+
+	void expand(const aabb& box) {
+		expand(box.minimum, box.maximum);
+	}
+
+	void expand(const point3& lo, const point3& hi) {
+		for (int a = 0; a < 3; a++) {
+			minimum.e[a] = lo.e[a] < minimum.e[a] ? lo.e[a] : minimum.e[a];
+			maximum.e[a] = hi.e[a] > maximum.e[a] ? hi.e[a] : maximum.e[a];
+		}
+	}
+
+	// Slab test. inv_dir is 1 / r.direction(), computed once per ray by the caller.
+	bool hit(const ray& r, const vec3& inv_dir, real t_min, real t_max) const {
+		for (int a = 0; a < 3; a++) {
+			auto t0 = (minimum[a] - r.orig[a]) * inv_dir[a];
+			auto t1 = (maximum[a] - r.orig[a]) * inv_dir[a];
+			if (inv_dir[a] < 0.0)
+				std::swap(t0, t1);
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_max < t_min)
+				return false;
+		}
+		return true;
+	}
+
+	bool hit(const ray& r, real t_min, real t_max) const {
+		vec3 d = r.direction();
+		return hit(r, vec3(1 / d.x(), 1 / d.y(), 1 / d.z()), t_min, t_max);
+	}
+
+public:
+	point3 minimum;
+	point3 maximum;
+};
+
+inline aabb surrounding_box(const aabb& box0, const aabb& box1) {
+	aabb box = box0;
+	box.expand(box1);
+	return box;
+}
+
+#endif
@@ -0,0 +1,309 @@
+#pragma once
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include <rtweekend.h>
+#include <trace.h>
+#include <space_filling.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// One pixel's sums as the buffer keeps them, for moving samples between
+// buffers (and processes, see distributed.h) with their variance estimate.
+struct pixel_sum
+{
+	float radiance[3];
+	float luminance_squares;
+	int32_t count;
+};
+
+// Float radiance framebuffer for progressive rendering.
+// Every pass adds one sample per pixel; the running sum and per-pixel sample
+// count are kept, so a render can stop at any point and be resumed later
+// without throwing away finished samples. The 8-bit display image is only a
+// view of it, produced by resolve(). The sum of squared luminance is kept as
+// well, for the variance estimate behind adaptive sampling.
+//
+// Pixels are addressed by their row-major index i + j * width throughout.
+// set_layout() can store them block by block instead, in the order a
+// render_engine with the same order and tile size visits them, so that
+// consecutive samples land in neighbouring memory.
+class accumulation_buffer
+{
+public:
+	accumulation_buffer() {}
+
+	void resize(int w, int h) {
+		image_width = w;
+		image_height = h;
+		size_t slots = size_t(w) * h;
+		if (block > 0) {
+			blocks_x = (w + block - 1) / block;
+			slots = size_t(blocks_x) * ((h + block - 1) / block) * block * block;
+		}
+		radiance.assign(slots * 3, 0.0f);
+		luminance_squares.assign(slots, 0.0f);
+		counts.assign(slots, 0);
+		completed_passes = 0;
+	}
+
+	// Row-major storage, or blocks of block x block pixels (rounded up to a
+	// power of two; padded at the right and bottom edges), each laid out
+	// along the order's curve. Clears the buffer.
+	void set_layout(pixel_order order, int block_size = 32) {
+		layout = order;
+		block = 0;
+		inner.clear();
+		if (order != pixel_order::row_major) {
+			block = int(next_power_of_two(uint32_t(std::max(block_size, 1))));
+			block_shift = 0;
+			while ((1 << block_shift) < block) {
+				block_shift++;
+			}
+			std::vector<curve_cell> cells = curve_cells(order, uint32_t(block));
+			inner.resize(cells.size());
+			for (size_t d = 0; d < cells.size(); d++) {
+				inner[(size_t(cells[d].y) << block_shift) | cells[d].x] = int32_t(d);
+			}
+		}
+		resize(image_width, image_height);
+	}
+
+	pixel_order storage_order() const { return layout; }
+
+	// Where a pixel's sums are stored.
+	size_t slot(int index) const {
+		if (block == 0)
+			return size_t(index);
+		int i = index % image_width;
+		int j = index / image_width;
+		int mask = block - 1;
+		size_t block_index = size_t(j >> block_shift) * blocks_x + (i >> block_shift);
+		return (block_index << (2 * block_shift)) + size_t(inner[((j & mask) << block_shift) | (i & mask)]);
+	}
+
+	void clear() {
+		resize(image_width, image_height);
+	}
+
+	int width() const { return image_width; }
+	int height() const { return image_height; }
+
+	// Safe from any thread as long as each pixel index has a single writer.
+	void add_sample(int index, const color& c) {
+		size_t k = slot(index);
+		float* p = &radiance[k * 3];
+		p[0] += static_cast<float>(c.x());
+		p[1] += static_cast<float>(c.y());
+		p[2] += static_cast<float>(c.z());
+		float y = static_cast<float>(luminance(c));
+		luminance_squares[k] += y * y;
+		counts[k]++;
+	}
+
+	int sample_count(int index) const {
+		return counts[slot(index)];
+	}
+
+	pixel_sum sum(int index) const {
+		size_t k = slot(index);
+		const float* p = &radiance[k * 3];
+		return { { p[0], p[1], p[2] }, luminance_squares[k], counts[k] };
+	}
+
+	// Adds samples taken elsewhere, as if add_sample() had taken them here.
+	void add_sum(int index, const pixel_sum& s) {
+		size_t k = slot(index);
+		float* p = &radiance[k * 3];
+		p[0] += s.radiance[0];
+		p[1] += s.radiance[1];
+		p[2] += s.radiance[2];
+		luminance_squares[k] += s.luminance_squares;
+		counts[k] += s.count;
+	}
+
+	long long total_samples() const {
+		long long total = 0;
+		for (int32_t n : counts) {
+			total += n;
+		}
+		return total;
+	}
+
+	int max_sample_count() const {
+		int most = 0;
+		for (int32_t n : counts) {
+			most = std::max(most, int(n));
+		}
+		return most;
+	}
+
+	// Standard error of the pixel's mean luminance relative to that mean
+	// (with dark pixels measured against min_luminance instead), from the
+	// sample variance. Infinite below two samples and while every sample was
+	// black: a pixel whose paths all died so far has no variance yet, not
+	// none at all.
+	double relative_error(int index, double min_luminance = 0.01) const {
+		size_t k = slot(index);
+		int n = counts[k];
+		if (n < 2)
+			return infinity;
+		const float* p = &radiance[k * 3];
+		double mean = luminance(color(p[0], p[1], p[2])) / n;
+		if (mean <= 0)
+			return infinity;
+		double variance = std::max(0.0, (luminance_squares[k] - n * mean * mean) / (n - 1));
+		return std::sqrt(variance / n) / std::max(mean, min_luminance);
+	}
+
+	color average(int index) const {
+		size_t k = slot(index);
+		int n = counts[k];
+		if (n == 0)
+			return color(0, 0, 0);
+		const float* p = &radiance[k * 3];
+		return color(p[0], p[1], p[2]) / n;
+	}
+
+	// Passes that covered every pixel; a cancelled pass is not counted even
+	// though the pixels it reached keep their extra sample.
+	int passes() const { return completed_passes; }
+	void end_pass() { completed_passes++; }
+
+	// Average, optionally gamma-correct (gamma 2), clamp and quantize one pixel to RGBA8.
+	void resolve_pixel(int index, uint8_t* rgba, bool fix_gamma) const {
+		color c = average(index);
+		double r = c.x();
+		double g = c.y();
+		double b = c.z();
+
+		if (fix_gamma) {
+			r = sqrt(r);
+			g = sqrt(g);
+			b = sqrt(b);
+		}
+
+		rgba[index * 4] = static_cast<uint8_t>(256 * clamp(r, 0.0, 0.999));
+		rgba[index * 4 + 1] = static_cast<uint8_t>(256 * clamp(g, 0.0, 0.999));
+		rgba[index * 4 + 2] = static_cast<uint8_t>(256 * clamp(b, 0.0, 0.999));
+		rgba[index * 4 + 3] = 255;
+	}
+
+	void resolve(uint8_t* rgba, bool fix_gamma) const {
+		RT_TRACE_ZONE("resolve");
+		for (int index = 0; index < image_width * image_height; index++) {
+			resolve_pixel(index, rgba, fix_gamma);
+		}
+	}
+
+	// Heatmap of the samples taken per pixel into RGBA8, black (none) through
+	// red and yellow to white (max_count or more).
+	void resolve_sample_counts(uint8_t* rgba, int max_count) const {
+		double scale = 3.0 / std::max(max_count, 1);
+		for (int index = 0; index < image_width * image_height; index++) {
+			double t = std::min(counts[slot(index)] * scale, 3.0);
+			rgba[index * 4] = static_cast<uint8_t>(255 * std::min(t, 1.0));
+			rgba[index * 4 + 1] = static_cast<uint8_t>(255 * clamp(t - 1, 0.0, 1.0));
+			rgba[index * 4 + 2] = static_cast<uint8_t>(255 * clamp(t - 2, 0.0, 1.0));
+			rgba[index * 4 + 3] = 255;
+		}
+	}
+
+	// Raw buffer contents, for checkpoints: size, passes, then the sums and
+	// counts in row-major order whatever the layout. read() restores the
+	// buffer exactly (into its current layout) or returns false and leaves
+	// it cleared.
+	bool write(FILE* file) const {
+		int32_t header[3] = { image_width, image_height, completed_passes };
+		if (fwrite(header, sizeof(header), 1, file) != 1)
+			return false;
+		if (block == 0)
+			return write_all(file, radiance) && write_all(file, luminance_squares) && write_all(file, counts);
+
+		int pixels = image_width * image_height;
+		std::vector<float> rgb(size_t(pixels) * 3);
+		std::vector<float> squares(pixels);
+		std::vector<int32_t> n(pixels);
+		for (int index = 0; index < pixels; index++) {
+			size_t k = slot(index);
+			for (int c = 0; c < 3; c++) {
+				rgb[size_t(index) * 3 + c] = radiance[k * 3 + c];
+			}
+			squares[index] = luminance_squares[k];
+			n[index] = counts[k];
+		}
+		return write_all(file, rgb) && write_all(file, squares) && write_all(file, n);
+	}
+
+	bool read(FILE* file) {
+		int32_t header[3];
+		if (fread(header, sizeof(header), 1, file) != 1 || header[0] < 0 || header[1] < 0 || header[2] < 0
+			|| int64_t(header[0]) * header[1] > (int64_t(1) << 28))
+			return false;
+		resize(header[0], header[1]);
+		if (block == 0) {
+			if (!read_all(file, radiance) || !read_all(file, luminance_squares) || !read_all(file, counts)) {
+				clear();
+				return false;
+			}
+			completed_passes = header[2];
+			return true;
+		}
+
+		int pixels = image_width * image_height;
+		std::vector<float> rgb(size_t(pixels) * 3);
+		std::vector<float> squares(pixels);
+		std::vector<int32_t> n(pixels);
+		if (!read_all(file, rgb) || !read_all(file, squares) || !read_all(file, n)) {
+			clear();
+			return false;
+		}
+		for (int index = 0; index < pixels; index++) {
+			size_t k = slot(index);
+			for (int c = 0; c < 3; c++) {
+				radiance[k * 3 + c] = rgb[size_t(index) * 3 + c];
+			}
+			luminance_squares[k] = squares[index];
+			counts[k] = n[index];
+		}
+		completed_passes = header[2];
+		return true;
+	}
+
+private:
+	template<typename T>
+	static bool write_all(FILE* file, const std::vector<T>& values) {
+		return values.empty() || fwrite(values.data(), sizeof(T), values.size(), file) == values.size();
+	}
+
+	template<typename T>
+	static bool read_all(FILE* file, std::vector<T>& values) {
+		return values.empty() || fread(values.data(), sizeof(T), values.size(), file) == values.size();
+	}
+
+	static double luminance(const color& c) {
+		return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+	}
+
+private:
+	int image_width = 0;
+	int image_height = 0;
+	std::vector<float> radiance;    // rgb sums, 3 floats per pixel
+	std::vector<float> luminance_squares;   // sums of squared luminance
+	std::vector<int32_t> counts;    // samples taken per pixel
+	std::atomic<int> completed_passes{ 0 };
+
+	pixel_order layout = pixel_order::row_major;
+	int block = 0;                  // 0: row-major storage
+	int block_shift = 0;
+	int blocks_x = 0;
+	std::vector<int32_t> inner;     // slot within a block, by (y << block_shift) | x
+
+};
+
+#endif
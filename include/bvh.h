@@ -0,0 +1,404 @@
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include <hittable.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <sphere_set.h>
+#include <trace.h>
+
+#include <algorithm>
+#include <vector>
+
+// Bounding volume hierarchy over the objects of a hittable_list.
+// The tree is flattened into one node array in depth-first order (the left
+// child of an inner node always follows it directly). Nodes are split along
+// the longest centroid axis with a binned surface area heuristic: one pass
+// to fill the bins and one std::partition per node, O(n log n) overall.
+// Traversal is a loop over a small index stack that visits the nearer child
+// first, so closer hits shrink t_max before the farther subtree is tested.
+// Leaves list their spheres first, copied by value into a contiguous array
+// in tree order, so they are intersected without a virtual call; other
+// objects go through hittable. With pack_spheres, leaves made only of
+// spheres are stored as one SIMD sphere_set instead.
+class bvh : public hittable
+{
+public:
+	bvh(const hittable_list& list, int max_leaf_size = 4, bool pack_spheres = false) : bvh(list.objects, max_leaf_size, pack_spheres) {}
+	bvh(const std::vector<shared_ptr<hittable>>& objects, int max_leaf_size = 4, bool pack_spheres = false);
+
+	virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
+	virtual void hit_packet(ray_packet& packet, real t_min) const override;
+
+	int node_count() const {
+		return static_cast<int>(nodes.size());
+	}
+
+private:
+	struct node {
+		aabb box;
+		int first;  // leaf: first entry in primitives; inner: index of the right child
+		int count;  // leaf: number of primitives; 0 marks an inner node
+		int axis;   // inner: split axis; leaf: how many of its primitives are leading spheres
+	};
+
+	struct build_entry {
+		aabb box;
+		point3 centroid;
+		int object;  // index into the source object list
+	};
+
+	static const int sah_bins = 16;
+	static const int sah_max_depth = 32;  // below it nodes fall back to median splits, bounding the depth to 64
+
+	struct range_bounds {
+		aabb box;        // of the primitives
+		aabb centroids;  // of their centroids
+	};
+
+	static range_bounds bounds_of(const std::vector<build_entry>& entries, int begin, int end);
+	int build(const std::vector<shared_ptr<hittable>>& objects, std::vector<build_entry>& entries, int begin, int end, const range_bounds& bounds, int depth);
+	int sah_split(std::vector<build_entry>& entries, int begin, int end, const aabb& centroids, int axis, range_bounds& left, range_bounds& right) const;
+	bool hit_leaf(const node& n, const ray& r, real t_min, real t_max, hit_record& rec) const;
+
+private:
+	int leaf_size;
+	bool pack;
+	std::vector<node> nodes;
+	std::vector<shared_ptr<hittable>> primitives;  // reordered so each leaf is a contiguous range
+	std::vector<sphere_data> spheres;              // parallel to primitives; valid for the leading spheres of a leaf
+	hittable_list unbounded;                       // objects without a bounding box, tested linearly
+};
+
+inline bvh::bvh(const std::vector<shared_ptr<hittable>>& objects, int max_leaf_size, bool pack_spheres)
+	: leaf_size(std::max(max_leaf_size, 1)), pack(pack_spheres) {
+	RT_TRACE_ZONE("build bvh");
+	std::vector<build_entry> entries;
+	entries.reserve(objects.size());
+
+	for (int i = 0; i < static_cast<int>(objects.size()); i++) {
+		aabb box;
+		if (objects[i]->bounding_box(box))
+			entries.push_back({ box, box.centroid(), i });
+		else
+			unbounded.add(objects[i]);
+	}
+
+	if (entries.empty())
+		return;
+
+	nodes.reserve(4 * entries.size() / leaf_size + 1);
+	primitives.reserve(entries.size());
+	spheres.reserve(entries.size());
+	int count = static_cast<int>(entries.size());
+	build(objects, entries, 0, count, bounds_of(entries, 0, count), 0);
+}
+
+inline bvh::range_bounds bvh::bounds_of(const std::vector<build_entry>& entries, int begin, int end) {
+	range_bounds bounds;
+	for (int i = begin; i < end; i++) {
+		bounds.box.expand(entries[i].box);
+		bounds.centroids.expand(entries[i].centroid);
+	}
+	return bounds;
+}
+
+inline int bvh::build(const std::vector<shared_ptr<hittable>>& objects, std::vector<build_entry>& entries, int begin, int end, const range_bounds& bounds, int depth) {
+	int index = static_cast<int>(nodes.size());
+	nodes.push_back(node());
+
+	if (end - begin <= leaf_size) {
+		int first = static_cast<int>(primitives.size());
+		std::vector<shared_ptr<hittable>> leaf;
+		for (int i = begin; i < end; i++) {
+			leaf.push_back(objects[entries[i].object]);
+		}
+
+		shared_ptr<sphere_set> packed;
+		if (pack && leaf.size() > 1) {
+			packed = make_shared<sphere_set>();
+			if (!sphere_set::from_list(leaf, *packed))
+				packed = nullptr;
+		}
+		if (packed) {
+			primitives.push_back(packed);
+			spheres.push_back(sphere_data());
+			nodes[index] = { bounds.box, first, 1, 0 };
+			return index;
+		}
+
+		// spheres first, so the leaf loops over them without dispatch
+		auto others = std::stable_partition(leaf.begin(), leaf.end(),
+			[](const shared_ptr<hittable>& object) { return dynamic_cast<const sphere*>(object.get()) != nullptr; });
+		int sphere_count = static_cast<int>(others - leaf.begin());
+		for (const auto& object : leaf) {
+			const sphere* s = dynamic_cast<const sphere*>(object.get());
+			spheres.push_back(s != nullptr ? sphere_data{ s->center, s->radius } : sphere_data());
+			primitives.push_back(object);
+		}
+
+		nodes[index] = { bounds.box, first, static_cast<int>(leaf.size()), sphere_count };
+		return index;
+	}
+
+	int axis = bounds.centroids.longest_axis();
+	range_bounds left, right;
+	int mid = depth < sah_max_depth ? sah_split(entries, begin, end, bounds.centroids, axis, left, right) : begin;
+	if (mid == begin || mid == end) {
+		// SAH found no useful split (or we are too deep): halve by count
+		mid = begin + (end - begin) / 2;
+		std::nth_element(entries.begin() + begin, entries.begin() + mid, entries.begin() + end,
+			[axis](const build_entry& a, const build_entry& b) { return a.centroid[axis] < b.centroid[axis]; });
+		left = bounds_of(entries, begin, mid);
+		right = bounds_of(entries, mid, end);
+	}
+
+	build(objects, entries, begin, mid, left, depth + 1);
+	int right_child = build(objects, entries, mid, end, right, depth + 1);
+	nodes[index] = { bounds.box, right_child, 0, axis };
+	return index;
+}
+
+// Bins the centroids along axis, picks the bin boundary with the lowest
+// left_count * left_area + right_count * right_area and partitions around it.
+// The bins already hold the bounds of both halves, so they are handed back
+// instead of being recomputed. Returns the partition point, or begin when no
+// boundary separates anything.
+inline int bvh::sah_split(std::vector<build_entry>& entries, int begin, int end, const aabb& centroids, int axis, range_bounds& left, range_bounds& right) const {
+	double lo = centroids.min()[axis];
+	double extent = centroids.max()[axis] - lo;
+	if (extent <= 0)
+		return begin;
+
+	double scale = sah_bins / extent;
+	auto bin_of = [&](const build_entry& e) {
+		return std::min(sah_bins - 1, static_cast<int>((e.centroid[axis] - lo) * scale));
+	};
+
+	range_bounds bin_bounds[sah_bins];
+	int bin_count[sah_bins] = {};
+	for (int i = begin; i < end; i++) {
+		int b = bin_of(entries[i]);
+		bin_bounds[b].box.expand(entries[i].box);
+		bin_bounds[b].centroids.expand(entries[i].centroid);
+		bin_count[b]++;
+	}
+
+	// right_area[b] / right_count[b] cover bins b..sah_bins-1
+	double right_area[sah_bins];
+	int right_count[sah_bins];
+	aabb accumulated;
+	int count = 0;
+	for (int b = sah_bins - 1; b > 0; b--) {
+		accumulated.expand(bin_bounds[b].box);
+		count += bin_count[b];
+		right_area[b] = count > 0 ? accumulated.surface_area() : 0;
+		right_count[b] = count;
+	}
+
+	int best = -1;
+	double best_cost = infinity;
+	accumulated = aabb();
+	count = 0;
+	for (int b = 0; b < sah_bins - 1; b++) {
+		accumulated.expand(bin_bounds[b].box);
+		count += bin_count[b];
+		if (count == 0 || right_count[b + 1] == 0)
+			continue;
+		double cost = count * accumulated.surface_area() + right_count[b + 1] * right_area[b + 1];
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = b;
+		}
+	}
+	if (best < 0)
+		return begin;
+
+	left = range_bounds();
+	right = range_bounds();
+	for (int b = 0; b < sah_bins; b++) {
+		range_bounds& side = b <= best ? left : right;
+		side.box.expand(bin_bounds[b].box);
+		side.centroids.expand(bin_bounds[b].centroids);
+	}
+
+	auto mid = std::partition(entries.begin() + begin, entries.begin() + end,
+		[&](const build_entry& e) { return bin_of(e) <= best; });
+	return static_cast<int>(mid - entries.begin());
+}
+
+inline bool bvh::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+	bool hit_anything = unbounded.hit(r, t_min, t_max, rec);
+	auto closest_so_far = hit_anything ? rec.t : t_max;
+
+	if (nodes.empty())
+		return hit_anything;
+
+	vec3 d = r.direction();
+	vec3 inv_dir(1 / d.x(), 1 / d.y(), 1 / d.z());
+
+	// build() keeps the tree under 64 levels
+	int stack[64];
+	int stack_size = 0;
+	int current = 0;
+	int visited = 0;
+	hit_record temp_rec;
+
+	while (true) {
+		const node& n = nodes[current];
+		visited++;
+		if (n.box.hit(r, inv_dir, t_min, closest_so_far)) {
+			if (n.count > 0) {
+				if (hit_leaf(n, r, t_min, closest_so_far, temp_rec)) {
+					hit_anything = true;
+					closest_so_far = temp_rec.t;
+					rec = temp_rec;
+				}
+			}
+			else {
+				// descend into the child on the ray's side of the split, defer the other
+				if (inv_dir[n.axis] < 0) {
+					stack[stack_size++] = current + 1;
+					current = n.first;
+				}
+				else {
+					stack[stack_size++] = n.first;
+					current = current + 1;
+				}
+				continue;
+			}
+		}
+		if (stack_size == 0)
+			break;
+		current = stack[--stack_size];
+	}
+	RT_COUNT_N(bvh_nodes, visited);
+	return hit_anything;
+}
+
+// Packet traversal for rays sharing an origin whose directions agree in sign
+// on every axis (true for a pixel block of a pinhole camera). Each node is
+// first tested against the whole packet with interval arithmetic over the
+// packets' inverse directions, which conservatively bounds the slab
+// distances of every ray at once, so a subtree no ray can reach is culled
+// with one test. Only leaves test rays individually. Other packets fall back
+// to single-ray traversal.
+inline void bvh::hit_packet(ray_packet& packet, real t_min) const {
+	if (nodes.empty() || !packet.coherent || packet.size == 0) {
+		hittable::hit_packet(packet, t_min);
+		return;
+	}
+
+	vec3 inv_dir[ray_packet::max_size];
+	vec3 inv_lo(infinity, infinity, infinity);
+	vec3 inv_hi(-infinity, -infinity, -infinity);
+	for (int k = 0; k < packet.size; k++) {
+		const vec3& d = packet.direction[k];
+		inv_dir[k] = vec3(1 / d.x(), 1 / d.y(), 1 / d.z());
+		for (int a = 0; a < 3; a++) {
+			inv_lo[a] = std::min(inv_lo[a], inv_dir[k][a]);
+			inv_hi[a] = std::max(inv_hi[a], inv_dir[k][a]);
+		}
+	}
+	for (int a = 0; a < 3; a++) {
+		// mixed signs (or an axis-parallel ray) break the interval bounds
+		if (!(inv_lo[a] > 0 || inv_hi[a] < 0) || std::isinf(inv_lo[a]) || std::isinf(inv_hi[a])) {
+			hittable::hit_packet(packet, t_min);
+			return;
+		}
+	}
+
+	if (!unbounded.objects.empty())
+		unbounded.hit_packet(packet, t_min);
+
+	const point3 o = packet.origin[0];
+	auto packet_far = [&] {
+		real far = t_min;
+		for (int k = 0; k < packet.size; k++) {
+			far = std::max(far, packet.t_max[k]);
+		}
+		return far;
+	};
+	real far = packet_far();
+
+	int stack[64];
+	int stack_size = 0;
+	int current = 0;
+	hit_record temp_rec;
+
+	while (true) {
+		const node& n = nodes[current];
+
+		// interval slab test: entry/exit distances over every direction in the packet
+		real enter = t_min;
+		real exit = far;
+		for (int a = 0; a < 3; a++) {
+			real near_plane = (inv_lo[a] > 0 ? n.box.minimum[a] : n.box.maximum[a]) - o[a];
+			real far_plane = (inv_lo[a] > 0 ? n.box.maximum[a] : n.box.minimum[a]) - o[a];
+			enter = std::max(enter, std::min(near_plane * inv_lo[a], near_plane * inv_hi[a]));
+			exit = std::min(exit, std::max(far_plane * inv_lo[a], far_plane * inv_hi[a]));
+		}
+
+		if (enter <= exit) {
+			if (n.count > 0) {
+				for (int k = 0; k < packet.size; k++) {
+					ray r(o, packet.direction[k]);
+					if (!n.box.hit(r, inv_dir[k], t_min, packet.t_max[k]))
+						continue;
+					if (hit_leaf(n, r, t_min, packet.t_max[k], temp_rec)) {
+						packet.hit[k] = true;
+						packet.t_max[k] = temp_rec.t;
+						packet.rec[k] = temp_rec;
+					}
+				}
+				far = packet_far();
+			}
+			else {
+				// every ray agrees on the sign, so they agree on the near child
+				if (inv_lo[n.axis] < 0) {
+					stack[stack_size++] = current + 1;
+					current = n.first;
+				}
+				else {
+					stack[stack_size++] = n.first;
+					current = current + 1;
+				}
+				continue;
+			}
+		}
+		if (stack_size == 0)
+			break;
+		current = stack[--stack_size];
+	}
+}
+
+// Nearest hit among the primitives of leaf n.
+inline bool bvh::hit_leaf(const node& n, const ray& r, real t_min, real t_max, hit_record& rec) const {
+	bool hit_anything = false;
+	int spheres_end = n.first + n.axis;
+	int end = n.first + n.count;
+	for (int i = n.first; i < spheres_end; i++) {
+		if (sphere::intersect(spheres[i], r, t_min, t_max, rec)) {
+			hit_anything = true;
+			t_max = rec.t;
+		}
+	}
+	for (int i = spheres_end; i < end; i++) {
+		if (primitives[i]->hit(r, t_min, t_max, rec)) {
+			hit_anything = true;
+			t_max = rec.t;
+		}
+	}
+	return hit_anything;
+}
+
+inline bool bvh::bounding_box(aabb& output_box) const {
+	if (nodes.empty() || !unbounded.objects.empty())
+		return false;
+	output_box = nodes[0].box;
+	return true;
+}
+
+#endif
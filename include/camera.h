@@ -8,17 +8,34 @@ class camera
 public:
     camera() {
         auto aspect_ratio = 16 / 9;
-        auto viewport_height = 2.0;
+        real viewport_height = 2;
         auto viewport_width = aspect_ratio * viewport_height;
-        auto focal_length = 1.0;
+        real focal_length = 1;
 
         origin = point3(0, 0, 0);
-        horizontal = vec3(viewport_width, 0.0, 0.0);
-        vertical = vec3(0.0, viewport_height, 0.0);
+        horizontal = vec3(viewport_width, 0, 0);
+        vertical = vec3(0, viewport_height, 0);
         lower_left_corner = origin - horizontal / 2 - vertical / 2 - vec3(0, 0, focal_length);
     }
 
-    ray get_ray(double u, double v) const {
+    // Looking from lookfrom at lookat with vup pointing up; vfov is the
+    // vertical field of view in degrees. The default camera is
+    // camera(point3(0, 0, 0), point3(0, 0, -1), vec3(0, 1, 0), 90, 1).
+    camera(point3 lookfrom, point3 lookat, vec3 vup, real vfov, real aspect_ratio) {
+        real viewport_height = real(2 * tan(degrees_to_radians(vfov) / 2));
+        real viewport_width = aspect_ratio * viewport_height;
+
+        vec3 w = unit_vector(lookfrom - lookat);
+        vec3 u = unit_vector(cross(vup, w));
+        vec3 v = cross(w, u);
+
+        origin = lookfrom;
+        horizontal = viewport_width * u;
+        vertical = viewport_height * v;
+        lower_left_corner = origin - horizontal / 2 - vertical / 2 - w;
+    }
+
+    ray get_ray(real u, real v) const {
         return ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
     }
 
@@ -0,0 +1,121 @@
+#pragma once
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <accumulation_buffer.h>
+#include <mapped_file.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// What a progressive render needs besides its accumulation buffer to be
+// resumed: the scene and every setting that changes the samples. There is no
+// generator state to save, since each sample's generator is seeded from
+// (seed, pixel, sample index) and the sample counts are in the buffer: a
+// resumed render takes exactly the samples the interrupted one would have.
+struct render_settings
+{
+	char scene[32] = {};            // as the caller names its scenes
+	int32_t scene_size = 0;         // e.g. sphere count, 0 if unused
+	int32_t target_passes = 0;
+	int32_t max_depth = 50;
+	int32_t seed = 0;
+	int32_t roulette = 1;
+	int32_t packets = 0;
+	int32_t adaptive = 0;
+	float target_error = 0;
+	int32_t sampler = 0;            // sampler_type, see sampler.h
+	char scene_file[260] = {};      // scene file rendered, empty for none
+	uint64_t scene_file_size = 0;   // its file_stamp() when saved
+	int64_t scene_file_modified = 0;
+
+	void set_scene(const std::string& name) {
+		memset(scene, 0, sizeof(scene));
+		strncpy(scene, name.c_str(), sizeof(scene) - 1);
+	}
+
+	// Records the scene file at path with its current stamp, or none if
+	// path is empty. False if the path is too long or the file cannot be
+	// read.
+	bool set_scene_file(const std::string& path) {
+		memset(scene_file, 0, sizeof(scene_file));
+		scene_file_size = 0;
+		scene_file_modified = 0;
+		if (path.empty())
+			return true;
+		if (path.size() >= sizeof(scene_file) || !file_stamp(path, scene_file_size, scene_file_modified))
+			return false;
+		memcpy(scene_file, path.c_str(), path.size());
+		return true;
+	}
+
+	// Whether the recorded scene file is still there and unchanged, so
+	// resuming renders the same scene (true if there is none).
+	bool scene_file_unchanged() const {
+		if (scene_file[0] == '\0')
+			return true;
+		uint64_t size;
+		int64_t modified;
+		return file_stamp(scene_file, size, modified) && size == scene_file_size && modified == scene_file_modified;
+	}
+};
+
+// Checkpoint file: magic, version, render_settings, then the accumulation
+// buffer (accumulation_buffer::write), about 20 bytes per pixel. It is
+// written to path + ".tmp" and renamed over path, so a crash while saving
+// leaves a complete checkpoint behind: the previous one, or on Windows,
+// where the old file has to be removed first, possibly only the new .tmp,
+// which load_checkpoint() falls back to.
+const uint32_t checkpoint_magic = 0x4b435452;  // "RTCK"
+// Version 3: cosine-weighted bounces (sampling.h). Older checkpoints hold
+// samples of the previous bounce distribution and are not resumed, since
+// mixing the two would bias the image. Version 4 adds the scene file, which
+// older ones did not record; version 5 stamps it to the nanosecond.
+const uint32_t checkpoint_version = 5;
+
+inline bool save_checkpoint(const std::string& path, const render_settings& settings, const accumulation_buffer& accum) {
+	std::string temp_path = path + ".tmp";
+	FILE* file = fopen(temp_path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	uint32_t header[2] = { checkpoint_magic, checkpoint_version };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1
+		&& fwrite(&settings, sizeof(settings), 1, file) == 1
+		&& accum.write(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		std::remove(temp_path.c_str());
+		return false;
+	}
+	// rename() does not replace an existing file on Windows
+	std::remove(path.c_str());
+	return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+// Restores settings and accum, or returns false and leaves settings as they
+// were (accum may be cleared).
+inline bool load_checkpoint(const std::string& path, render_settings& settings, accumulation_buffer& accum) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		file = fopen((path + ".tmp").c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	uint32_t header[2];
+	render_settings loaded;
+	bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == checkpoint_magic
+		&& header[1] == checkpoint_version
+		&& fread(&loaded, sizeof(loaded), 1, file) == 1
+		&& accum.read(file);
+	fclose(file);
+	if (ok) {
+		loaded.scene[sizeof(loaded.scene) - 1] = '\0';
+		loaded.scene_file[sizeof(loaded.scene_file) - 1] = '\0';
+		settings = loaded;
+	}
+	return ok;
+}
+
+#endif
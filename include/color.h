@@ -3,13 +3,34 @@
 
 #include "vec3.h"
 
+#include <cstdint>
 #include <iostream>
 
-void write_color(std::ostream& out, color pixel_color) {
+inline void write_color(std::ostream& out, color pixel_color) {
     // Write the translated [0,255] value of each color component.
     out << static_cast<int>(255.999 * pixel_color.x()) << ' '
         << static_cast<int>(255.999 * pixel_color.y()) << ' '
         << static_cast<int>(255.999 * pixel_color.z()) << '\n';
 }
 
+// Writes the color into pixel `index` of an RGBA8 buffer: scaled (e.g. by
+// 1 / samples), optionally gamma-corrected (gamma 2), then translated to
+// [0,255] like write_color.
+inline void write_rgba(uint8_t* rgba, int index, color pixel_color, double scale = 1.0, bool fix_gamma = false) {
+    double r = pixel_color.x() * scale;
+    double g = pixel_color.y() * scale;
+    double b = pixel_color.z() * scale;
+
+    if (fix_gamma) {
+        r = sqrt(r);
+        g = sqrt(g);
+        b = sqrt(b);
+    }
+
+    rgba[index * 4] = static_cast<int>(255.999 * r);
+    rgba[index * 4 + 1] = static_cast<int>(255.999 * g);
+    rgba[index * 4 + 2] = static_cast<int>(255.999 * b);
+    rgba[index * 4 + 3] = 255;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef COMPILED_SCENE_H
+#define COMPILED_SCENE_H
+
+#include <hittable.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <sphere_set.h>
+
+// Flattened, devirtualized copy of a hittable_list for rendering.
+// Scenes are still built with hittable_list and shared_ptr; compiling one
+// walks it (nested lists included) and copies every primitive of a known
+// type by value into a contiguous array of that type (spheres into a
+// sphere_set, so they also get its SIMD kernels), which hit() loops over
+// with no virtual call and no pointer to follow per object. Objects of other
+// types keep working through a fallback list. The copy does not track later
+// changes to the source list.
+class compiled_scene : public hittable
+{
+public:
+	compiled_scene() {}
+	explicit compiled_scene(const hittable_list& list) {
+		add(list);
+	}
+
+	void add(const hittable_list& list) {
+		for (const auto& object : list.objects) {
+			add(object);
+		}
+	}
+
+	void add(const shared_ptr<hittable>& object) {
+		if (const sphere* s = dynamic_cast<const sphere*>(object.get()))
+			spheres.add(s->center, s->radius);
+		else if (const hittable_list* list = dynamic_cast<const hittable_list*>(object.get()))
+			add(*list);
+		else
+			others.add(object);
+	}
+
+	int sphere_count() const {
+		return spheres.size();
+	}
+
+	int other_count() const {
+		return static_cast<int>(others.objects.size());
+	}
+
+	virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override {
+		bool hit_anything = spheres.hit(r, t_min, t_max, rec);
+		real closest_so_far = hit_anything ? rec.t : t_max;
+		hit_record temp_rec;
+		if (!others.objects.empty() && others.hit(r, t_min, closest_so_far, temp_rec)) {
+			hit_anything = true;
+			rec = temp_rec;
+		}
+		return hit_anything;
+	}
+
+	virtual bool bounding_box(aabb& output_box) const override {
+		if (spheres.size() == 0 && others.objects.empty())
+			return false;
+		output_box = aabb();
+		if (spheres.size() > 0)
+			spheres.bounding_box(output_box);
+		aabb others_box;
+		if (!others.objects.empty()) {
+			if (!others.bounding_box(others_box))
+				return false;
+			output_box.expand(others_box);
+		}
+		return true;
+	}
+
+private:
+	sphere_set spheres;
+	hittable_list others;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Runtime SIMD detection, so one binary can run its AVX2 kernels where the
+// CPU (and OS) support them and fall back elsewhere.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define RT_X86 0
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions marked for it;
+// MSVC accepts the intrinsics anywhere.
+#if RT_X86 && !defined(_MSC_VER)
+#define RT_TARGET_SSE2 __attribute__((target("sse2")))
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RT_TARGET_SSE2
+#define RT_TARGET_AVX2
+#endif
+
+enum class simd_level { scalar = 0, sse2 = 1, avx2 = 2 };
+
+inline const char* simd_level_name(simd_level level) {
+    switch (level) {
+    case simd_level::sse2: return "sse2";
+    case simd_level::avx2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+inline simd_level detect_simd_level() {
+#if RT_X86
+    unsigned regs[4] = { 0, 0, 0, 0 };  // eax, ebx, ecx, edx
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    unsigned max_leaf = info[0];
+    __cpuid(info, 1);
+    for (int i = 0; i < 4; i++) regs[i] = info[i];
+#else
+    unsigned max_leaf = __get_cpuid_max(0, nullptr);
+    __get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+    bool sse2 = (regs[3] & (1u << 26)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+
+    bool avx2 = false;
+    if (max_leaf >= 7 && osxsave && avx) {
+#ifdef _MSC_VER
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        unsigned long long xcr0 = _xgetbv(0);
+#else
+        __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+        avx2 = (regs[1] & (1u << 5)) != 0;
+        unsigned xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        unsigned long long xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+#endif
+        // the OS must save the YMM registers on context switches
+        avx2 = avx2 && (xcr0 & 6) == 6;
+    }
+
+    if (avx2)
+        return simd_level::avx2;
+    if (sse2)
+        return simd_level::sse2;
+#endif
+    return simd_level::scalar;
+}
+
+// Detected once, on first use.
+inline simd_level cpu_simd_level() {
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef DIRTY_TILES_H
+#define DIRTY_TILES_H
+
+#include <render_engine.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Which tiles of a framebuffer changed since they were last taken.
+// Render threads mark() the blocks they finish; the display thread take()s
+// the changed rectangles and uploads only those. Marking and taking may run
+// concurrently; resize() may not run concurrently with either.
+class dirty_tiles
+{
+public:
+	dirty_tiles() {}
+
+	// Every tile starts out dirty.
+	void resize(int width, int height, int tile_size = 32) {
+		image_width = width;
+		image_height = height;
+		size = tile_size;
+		columns = (width + tile_size - 1) / tile_size;
+		rows = (height + tile_size - 1) / tile_size;
+		flags.reset(new std::atomic<bool>[size_t(columns) * rows]);
+		mark_all();
+	}
+
+	int width() const { return image_width; }
+	int height() const { return image_height; }
+
+	void mark(const tile& t) {
+		int cx0 = std::max(t.x0, 0) / size;
+		int cy0 = std::max(t.y0, 0) / size;
+		int cx1 = std::min((t.x1 + size - 1) / size, columns);
+		int cy1 = std::min((t.y1 + size - 1) / size, rows);
+		for (int cy = cy0; cy < cy1; cy++) {
+			for (int cx = cx0; cx < cx1; cx++) {
+				flags[cy * columns + cx].store(true, std::memory_order_release);
+			}
+		}
+	}
+
+	void mark_all() {
+		for (int k = 0; k < columns * rows; k++) {
+			flags[k].store(true, std::memory_order_release);
+		}
+	}
+
+	// Clears the dirty tiles and returns them, runs of neighbours in a row
+	// merged into one rectangle.
+	std::vector<tile> take() {
+		std::vector<tile> changed;
+		for (int cy = 0; cy < rows; cy++) {
+			int run = -1;
+			for (int cx = 0; cx <= columns; cx++) {
+				bool dirty = cx < columns && flags[cy * columns + cx].exchange(false, std::memory_order_acquire);
+				if (dirty && run < 0)
+					run = cx;
+				if (!dirty && run >= 0) {
+					changed.push_back({ run * size, cy * size, std::min(cx * size, image_width), std::min((cy + 1) * size, image_height) });
+					run = -1;
+				}
+			}
+		}
+		return changed;
+	}
+
+private:
+	int image_width = 0;
+	int image_height = 0;
+	int size = 32;
+	int columns = 0;
+	int rows = 0;
+	std::unique_ptr<std::atomic<bool>[]> flags;
+};
+
+#endif
@@ -0,0 +1,450 @@
+#pragma once
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <camera.h>
+#include <bvh.h>
+#include <compiled_scene.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <path_tracer.h>
+#include <scene_file.h>
+#include <scene_arena.h>
+#include <scenes.h>
+#include <net_socket.h>
+#include <trace.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Rendering one image with several processes, on one machine or many.
+//
+// Worker processes listen on an address (net_socket.h). The coordinator
+// connects to each, sends the job once per connection: the settings, the
+// camera and every sphere of the scene. After that it hands out tiles, a
+// few per worker at a time so none sits idle waiting for the next, and
+// adds the pixel sums that come back into its accumulation_buffer. A worker
+// that disconnects (or stays silent longer than timeout_seconds) is dropped
+// and its unfinished tiles go back to the queue for the others.
+//
+// Workers seed every sample with seed_pixel_rng() as progressive_renderer
+// does, so the image is the same whichever worker rendered which tile, and
+// the same as rendering it in one process. Messages are in native byte
+// order and the workers must be built with the same real as the
+// coordinator, which the job checks.
+
+// What a worker needs to render any tile of the image.
+struct distributed_job
+{
+	int width = 0;
+	int height = 0;
+	int samples_per_pixel = 1;
+	int max_depth = 50;
+	int seed = 0;
+	bool roulette = true;
+	bool normals = false;       // shade with normal_color instead of the path tracer
+	bool use_bvh = false;       // bvh instead of compiled_scene
+	camera cam;
+	std::vector<scene_sphere> spheres;
+};
+
+// Every message is a header and size bytes of payload.
+struct tile_message
+{
+	enum type_id : uint32_t { job = 1, tile = 2, result = 3, done = 4 };
+
+	uint32_t type;
+	uint32_t reserved;
+	uint64_t size;
+};
+
+// Payload of a tile message; a result repeats it, followed by one pixel_sum
+// per pixel of the rectangle, row by row.
+struct tile_request
+{
+	int32_t id;
+	int32_t x0, y0, x1, y1;
+};
+
+// Start of the job payload; the spheres follow.
+struct job_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t real_size;
+	int32_t width;
+	int32_t height;
+	int32_t samples_per_pixel;
+	int32_t max_depth;
+	int32_t seed;
+	int32_t roulette;
+	int32_t normals;
+	int32_t use_bvh;
+	int32_t reserved;
+	uint64_t sphere_count;
+	uint8_t camera_bytes[sizeof(camera)];
+};
+
+static_assert(std::is_trivially_copyable<camera>::value, "the job sends the camera as bytes");
+static_assert(sizeof(pixel_sum) == 20, "results send pixel_sum as bytes");
+
+inline bool send_message(net_socket& connection, uint32_t type, const void* payload, size_t size, const void* more = nullptr, size_t more_size = 0) {
+	tile_message header = { type, 0, uint64_t(size + more_size) };
+	return connection.send_all(&header, sizeof(header)) && (size == 0 || connection.send_all(payload, size))
+		&& (more_size == 0 || connection.send_all(more, more_size));
+}
+
+// Renders the tiles of one coordinator after another.
+class tile_worker
+{
+public:
+	explicit tile_worker(render_engine& engine) : engine(engine) {}
+
+	// Serves one job on an accepted connection until the coordinator says
+	// done (true) or the connection breaks or sends nonsense (false).
+	bool run(net_socket& connection, std::string& error) {
+		tiles_rendered = 0;
+		sphere_count = 0;
+		tile_message header;
+		std::vector<uint8_t> payload;
+		if (!receive(connection, header, payload) || header.type != tile_message::job) {
+			error = "no job received";
+			return false;
+		}
+		distributed_job job;
+		if (!read_job(payload, job, error))
+			return false;
+		sphere_count = job.spheres.size();
+
+		scene_arena arena;
+		scene_file file;
+		file.set_spheres(std::move(job.spheres));
+		hittable_list world = file.make_world(&arena);
+		std::unique_ptr<hittable> target;
+		if (job.use_bvh)
+			target.reset(new bvh(world));
+		else
+			target.reset(new compiled_scene(world));
+		path_tracer tracer(job.max_depth, job.roulette ? 3 : job.max_depth);
+
+		std::vector<uint8_t> result;
+		while (receive(connection, header, payload)) {
+			if (header.type == tile_message::done)
+				return true;
+			tile_request request;
+			if (header.type != tile_message::tile || payload.size() != sizeof(request)) {
+				error = "unexpected message";
+				return false;
+			}
+			memcpy(&request, payload.data(), sizeof(request));
+			if (request.x0 < 0 || request.y0 < 0 || request.x1 > job.width || request.y1 > job.height
+				|| request.x0 >= request.x1 || request.y0 >= request.y1) {
+				error = "tile outside the image";
+				return false;
+			}
+			render_tile(job, *target, tracer, request, result);
+			if (!send_message(connection, tile_message::result, &request, sizeof(request), result.data(), result.size())) {
+				error = "coordinator went away";
+				return false;
+			}
+			tiles_rendered++;
+		}
+		error = "coordinator went away";
+		return false;
+	}
+
+public:
+	int tiles_rendered = 0;     // by the last run()
+	size_t sphere_count = 0;    // in its scene
+
+private:
+	static bool receive(net_socket& connection, tile_message& header, std::vector<uint8_t>& payload) {
+		if (!connection.recv_all(&header, sizeof(header)) || header.size > (uint64_t(1) << 34))
+			return false;
+		payload.resize(static_cast<size_t>(header.size));
+		return payload.empty() || connection.recv_all(payload.data(), payload.size());
+	}
+
+	static bool read_job(const std::vector<uint8_t>& payload, distributed_job& job, std::string& error) {
+		job_header h;
+		if (payload.size() < sizeof(h)) {
+			error = "job too short";
+			return false;
+		}
+		memcpy(&h, payload.data(), sizeof(h));
+		if (memcmp(h.magic, "RTJB", 4) != 0 || h.version != 1) {
+			error = "not a job of this version";
+			return false;
+		}
+		if (h.real_size != sizeof(real)) {
+			error = h.real_size == sizeof(float) ? "the coordinator renders in float, this worker in double"
+				: "the coordinator renders in double, this worker in float";
+			return false;
+		}
+		if (h.width < 2 || h.height < 2 || h.samples_per_pixel < 1 || h.max_depth < 0
+			|| h.sphere_count * sizeof(scene_sphere) != payload.size() - sizeof(h)) {
+			error = "bad job";
+			return false;
+		}
+		job.width = h.width;
+		job.height = h.height;
+		job.samples_per_pixel = h.samples_per_pixel;
+		job.max_depth = h.max_depth;
+		job.seed = h.seed;
+		job.roulette = h.roulette != 0;
+		job.normals = h.normals != 0;
+		job.use_bvh = h.use_bvh != 0;
+		memcpy(&job.cam, h.camera_bytes, sizeof(camera));
+		job.spheres.resize(static_cast<size_t>(h.sphere_count));
+		if (!job.spheres.empty())
+			memcpy(job.spheres.data(), payload.data() + sizeof(h), job.spheres.size() * sizeof(scene_sphere));
+		return true;
+	}
+
+	// Every sample of every pixel of the tile, seeded as progressive_renderer
+	// seeds the same sample of the same pixel.
+	void render_tile(const distributed_job& job, const hittable& world, const path_tracer& tracer, const tile_request& t, std::vector<uint8_t>& result) {
+		RT_TRACE_ZONE("remote tile");
+		int w = t.x1 - t.x0;
+		int h = t.y1 - t.y0;
+		accumulation_buffer sums;
+		sums.resize(w, h);
+		engine.render(w, h, [&](int li, int lj) {
+			int i = t.x0 + li;
+			int j = t.y0 + lj;
+			int index = i + j * job.width;
+			for (int s = 0; s < job.samples_per_pixel; s++) {
+				seed_pixel_rng(job.seed, index, s);
+				auto u = real((i + random_double2()) / (job.width - 1));
+				auto v = real((j + random_double2()) / (job.height - 1));
+				ray r = job.cam.get_ray(u, v);
+				sums.add_sample(li + lj * w, job.normals ? normal_color(r, world) : tracer.trace(r, world));
+			}
+		});
+		result.resize(size_t(w) * h * sizeof(pixel_sum));
+		for (int k = 0; k < w * h; k++) {
+			pixel_sum s = sums.sum(k);
+			memcpy(&result[size_t(k) * sizeof(pixel_sum)], &s, sizeof(s));
+		}
+	}
+
+private:
+	render_engine& engine;
+};
+
+// Splits an image into tiles and renders them on the workers.
+class tile_coordinator
+{
+public:
+	struct worker_report
+	{
+		std::string address;
+		bool connected = false;
+		bool failed = false;        // dropped before the end
+		int tiles = 0;              // results it delivered
+		std::string error;
+	};
+
+	// Renders the whole job into accum, which must have the image size.
+	// False (with error) if the workers died before every tile was done.
+	bool render(const distributed_job& job, accumulation_buffer& accum, std::string& error) {
+		RT_TRACE_ZONE("distributed render");
+		std::vector<uint8_t> job_payload = make_job_payload(job);
+		tiles = make_tiles(job.width, job.height, tile_size);
+		queue.clear();
+		for (int k = 0; k < static_cast<int>(tiles.size()); k++) {
+			queue.push_back(k);
+		}
+		finished_count = 0;
+		reassigned = 0;
+		live_workers = static_cast<int>(workers.size());
+		reports.assign(workers.size(), worker_report());
+
+		std::vector<std::thread> threads;
+		for (size_t w = 0; w < workers.size(); w++) {
+			reports[w].address = workers[w];
+			threads.emplace_back([this, w, &job, &job_payload, &accum] { serve_worker(reports[w], job, job_payload, accum); });
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		if (finished_count < static_cast<int>(tiles.size())) {
+			error = "every worker failed, " + std::to_string(tiles.size() - finished_count) + " tiles not rendered";
+			return false;
+		}
+		for (int p = 0; p < job.samples_per_pixel; p++) {
+			accum.end_pass();
+		}
+		return true;
+	}
+
+	// Fraction of the tiles finished so far.
+	float progress() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return tiles.empty() ? 0.0f : float(finished_count) / tiles.size();
+	}
+
+public:
+	std::vector<std::string> workers;   // addresses
+	int tile_size = 64;
+	int tiles_in_flight = 2;            // per worker
+	double timeout_seconds = 0;         // 0: wait for results forever
+	std::function<void(const tile&)> tile_done;   // called on the coordinator's threads
+
+	std::vector<worker_report> reports; // of the last render()
+	int reassigned = 0;                 // tiles taken back from failed workers
+
+private:
+	static std::vector<uint8_t> make_job_payload(const distributed_job& job) {
+		job_header h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, "RTJB", 4);
+		h.version = 1;
+		h.real_size = sizeof(real);
+		h.width = job.width;
+		h.height = job.height;
+		h.samples_per_pixel = job.samples_per_pixel;
+		h.max_depth = job.max_depth;
+		h.seed = job.seed;
+		h.roulette = job.roulette ? 1 : 0;
+		h.normals = job.normals ? 1 : 0;
+		h.use_bvh = job.use_bvh ? 1 : 0;
+		h.sphere_count = job.spheres.size();
+		memcpy(h.camera_bytes, &job.cam, sizeof(camera));
+
+		std::vector<uint8_t> payload(sizeof(h) + job.spheres.size() * sizeof(scene_sphere));
+		memcpy(payload.data(), &h, sizeof(h));
+		if (!job.spheres.empty())
+			memcpy(payload.data() + sizeof(h), job.spheres.data(), job.spheres.size() * sizeof(scene_sphere));
+		return payload;
+	}
+
+	// Next tile to send: -1 if none is queued right now, or, with wait,
+	// only once every tile is finished or no worker is left to finish them.
+	int take_tile(bool wait) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (wait) {
+			changed.wait(lock, [this] {
+				return !queue.empty() || finished_count == static_cast<int>(tiles.size()) || live_workers == 0;
+			});
+		}
+		if (queue.empty())
+			return -1;
+		int k = queue.front();
+		queue.pop_front();
+		return k;
+	}
+
+	// A dropped worker's tiles go back to the front of the queue.
+	void fail_worker(worker_report& report, const std::vector<int>& in_flight, const std::string& why) {
+		std::lock_guard<std::mutex> lock(mutex);
+		report.failed = true;
+		report.error = why;
+		for (auto k = in_flight.rbegin(); k != in_flight.rend(); ++k) {
+			queue.push_front(*k);
+			reassigned++;
+		}
+		live_workers--;
+		changed.notify_all();
+	}
+
+	void serve_worker(worker_report& report, const distributed_job& job, const std::vector<uint8_t>& job_payload, accumulation_buffer& accum) {
+		net_socket connection;
+		std::vector<int> in_flight;
+		if (!connection.connect(report.address, report.error)) {
+			fail_worker(report, in_flight, report.error);
+			return;
+		}
+		report.connected = true;
+		if (timeout_seconds > 0)
+			connection.set_receive_timeout(timeout_seconds);
+		if (!send_message(connection, tile_message::job, job_payload.data(), job_payload.size())) {
+			fail_worker(report, in_flight, "cannot send the job");
+			return;
+		}
+
+		std::vector<pixel_sum> pixels;
+		while (true) {
+			// keep tiles_in_flight tiles queued on the worker; block for one
+			// only when it has none at all
+			while (static_cast<int>(in_flight.size()) < tiles_in_flight) {
+				int k = take_tile(in_flight.empty());
+				if (k < 0)
+					break;
+				const tile& t = tiles[k];
+				tile_request request = { k, t.x0, t.y0, t.x1, t.y1 };
+				in_flight.push_back(k);
+				if (!send_message(connection, tile_message::tile, &request, sizeof(request))) {
+					fail_worker(report, in_flight, "connection lost");
+					return;
+				}
+			}
+			if (in_flight.empty())
+				break;
+
+			tile_message header;
+			tile_request request;
+			if (!connection.recv_all(&header, sizeof(header)) || header.type != tile_message::result
+				|| header.size < sizeof(request) || !connection.recv_all(&request, sizeof(request))) {
+				fail_worker(report, in_flight, "connection lost");
+				return;
+			}
+			auto position = std::find(in_flight.begin(), in_flight.end(), request.id);
+			if (position == in_flight.end()) {
+				fail_worker(report, in_flight, "result for a tile it was not given");
+				return;
+			}
+			const tile& t = tiles[request.id];
+			size_t count = size_t(t.x1 - t.x0) * (t.y1 - t.y0);
+			pixels.resize(count);
+			if (header.size != sizeof(request) + count * sizeof(pixel_sum) || !connection.recv_all(pixels.data(), count * sizeof(pixel_sum))) {
+				fail_worker(report, in_flight, "connection lost");
+				return;
+			}
+			in_flight.erase(position);
+			store_tile(request.id, pixels, job.width, accum);
+			report.tiles++;
+		}
+		send_message(connection, tile_message::done, nullptr, 0);
+	}
+
+	void store_tile(int k, const std::vector<pixel_sum>& pixels, int width, accumulation_buffer& accum) {
+		const tile& t = tiles[k];
+		int w = t.x1 - t.x0;
+		// pixels of different tiles never overlap, so only the bookkeeping is locked
+		for (int j = t.y0; j < t.y1; j++) {
+			for (int i = t.x0; i < t.x1; i++) {
+				accum.add_sum(i + j * width, pixels[(j - t.y0) * w + (i - t.x0)]);
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finished_count++;
+			changed.notify_all();
+		}
+		if (tile_done)
+			tile_done(t);
+	}
+
+private:
+	std::vector<tile> tiles;
+	std::deque<int> queue;          // tiles waiting for a worker
+	int finished_count = 0;
+	int live_workers = 0;
+	mutable std::mutex mutex;
+	std::condition_variable changed;
+};
+
+#endif
@@ -4,12 +4,13 @@
 #define HITTABLE_H
 
 #include<ray.h>
+#include<aabb.h>
 
 struct hit_record
 {
 	point3 p; 
 	vec3 normal;
-	double t;
+	real t;
 	bool front_face;
 
 	inline void set_face_normal(const ray& r, const vec3& outward_normal) {
@@ -18,9 +19,56 @@ struct hit_record
 	}
 };
 
+// A bundle of up to max_size rays traced together, e.g. the primary rays of
+// an 8x8 pixel block. Rays are coherent when they share one origin, which is
+// what a bvh needs to cull whole subtrees against the packet at once.
+struct ray_packet
+{
+	static const int max_size = 64;
+
+	int size = 0;
+	bool coherent = true;       // every ray starts at origin[0]
+	point3 origin[max_size];
+	vec3 direction[max_size];
+	real t_max[max_size];     // closest hit so far, initially the far limit
+	bool hit[max_size];
+	hit_record rec[max_size];
+
+	void add(const ray& r, real far = infinity) {
+		point3 o = r.origin();
+		if (size > 0 && (o.x() != origin[0].x() || o.y() != origin[0].y() || o.z() != origin[0].z()))
+			coherent = false;
+		origin[size] = o;
+		direction[size] = r.direction();
+		t_max[size] = far;
+		hit[size] = false;
+		size++;
+	}
+
+	ray get(int k) const {
+		return ray(origin[k], direction[k]);
+	}
+};
+
 class hittable {
 public:
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+	virtual ~hittable() {}
+
+	virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const = 0;
+	// false when the object has no finite bounds (e.g. an empty list)
+	virtual bool bounding_box(aabb& output_box) const = 0;
+
+	// Nearest hit for every ray of the packet, filling hit[], rec[] and
+	// t_max[]. The default traces the rays one by one; acceleration
+	// structures override it to share traversal work between them.
+	virtual void hit_packet(ray_packet& packet, real t_min) const {
+		for (int k = 0; k < packet.size; k++) {
+			if (hit(packet.get(k), t_min, packet.t_max[k], packet.rec[k])) {
+				packet.hit[k] = true;
+				packet.t_max[k] = packet.rec[k].t;
+			}
+		}
+	}
 };
 
 
@@ -3,6 +3,7 @@
 #define HITTABLE_LIST_H
 
 #include<hittable.h>
+#include<render_stats.h>
 
 #include<memory>
 #include<vector>
@@ -26,14 +27,16 @@ public:
 
 	~hittable_list() {}
 
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
 
 public:
 	std::vector<shared_ptr<hittable>> objects;
 };
 
-bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+inline bool hittable_list::hit(const ray& r, real t_min, real t_max, hit_record& rec) const
 {
+	RT_COUNT(list_hits);
 	hit_record temp_rec;
 	bool hit_anything = false;
 	auto closet_so_far = t_max;
@@ -48,6 +51,21 @@ bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& re
 	return hit_anything;
 }
 
+inline bool hittable_list::bounding_box(aabb& output_box) const
+{
+	if (objects.empty())
+		return false;
+
+	aabb temp_box;
+	output_box = aabb();
+	for (const auto& object : objects) {
+		if (!object->bounding_box(temp_box))
+			return false;
+		output_box.expand(temp_box);
+	}
+	return true;
+}
+
 
 
 
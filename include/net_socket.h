@@ -0,0 +1,259 @@
+#pragma once
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+// minwindef.h defines these away, which breaks any later use as a name
+#undef near
+#undef far
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Blocking stream socket, just what the tile protocol needs.
+// Addresses are "host:port" for TCP or "unix:PATH" for a Unix-domain socket
+// (POSIX only). send_all() and recv_all() move whole buffers and fail
+// once the peer is gone, so a dead process shows up as a false return
+// rather than a signal.
+class net_socket
+{
+public:
+	net_socket() {}
+	~net_socket() {
+		close();
+	}
+
+	net_socket(net_socket&& other) : handle(other.handle) {
+		other.handle = invalid_handle;
+	}
+
+	net_socket& operator=(net_socket&& other) {
+		if (this != &other) {
+			close();
+			handle = other.handle;
+			other.handle = invalid_handle;
+		}
+		return *this;
+	}
+
+	net_socket(const net_socket&) = delete;
+	net_socket& operator=(const net_socket&) = delete;
+
+	bool is_open() const {
+		return handle != invalid_handle;
+	}
+
+	bool connect(const std::string& address, std::string& error) {
+		return open(address, false, error);
+	}
+
+	// Binds and listens; a stale Unix socket file at the path is replaced.
+	bool listen(const std::string& address, std::string& error) {
+		return open(address, true, error);
+	}
+
+	// Waits for the next connection; a closed socket on failure.
+	net_socket accept() {
+		net_socket connection;
+		connection.handle = ::accept(handle, nullptr, nullptr);
+		connection.set_no_delay();
+		return connection;
+	}
+
+	bool send_all(const void* data, size_t size) {
+		const char* p = static_cast<const char*>(data);
+		while (size > 0) {
+			int chunk = static_cast<int>(size < max_chunk ? size : max_chunk);
+			int sent = static_cast<int>(::send(handle, p, chunk, send_flags));
+			if (sent <= 0)
+				return false;
+			p += sent;
+			size -= size_t(sent);
+		}
+		return true;
+	}
+
+	bool recv_all(void* data, size_t size) {
+		char* p = static_cast<char*>(data);
+		while (size > 0) {
+			int chunk = static_cast<int>(size < max_chunk ? size : max_chunk);
+			int received = static_cast<int>(::recv(handle, p, chunk, 0));
+			if (received <= 0)
+				return false;
+			p += received;
+			size -= size_t(received);
+		}
+		return true;
+	}
+
+	// recv_all() gives up after this long without data; 0 waits forever.
+	void set_receive_timeout(double seconds) {
+#ifdef _WIN32
+		DWORD ms = static_cast<DWORD>(seconds * 1000);
+		setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+		timeval tv;
+		tv.tv_sec = static_cast<long>(seconds);
+		tv.tv_usec = static_cast<long>((seconds - tv.tv_sec) * 1e6);
+		setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+	}
+
+	void close() {
+		if (handle == invalid_handle)
+			return;
+#ifdef _WIN32
+		closesocket(handle);
+#else
+		::close(handle);
+#endif
+		handle = invalid_handle;
+	}
+
+private:
+#ifdef _WIN32
+	using native_handle = SOCKET;
+	static const native_handle invalid_handle = INVALID_SOCKET;
+#else
+	using native_handle = int;
+	static const native_handle invalid_handle = -1;
+#endif
+	static const size_t max_chunk = 1 << 20;
+#ifdef MSG_NOSIGNAL
+	static const int send_flags = MSG_NOSIGNAL;
+#else
+	static const int send_flags = 0;
+#endif
+
+	bool open(const std::string& address, bool server, std::string& error) {
+		close();
+		startup();
+		if (address.compare(0, 5, "unix:") == 0)
+			return open_unix(address.substr(5), server, error);
+
+		size_t colon = address.rfind(':');
+		if (colon == std::string::npos) {
+			error = "bad address '" + address + "', expected host:port or unix:path";
+			return false;
+		}
+		std::string host = address.substr(0, colon);
+		std::string port = address.substr(colon + 1);
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = server ? AI_PASSIVE : 0;
+		addrinfo* found = nullptr;
+		if (getaddrinfo(host.empty() || host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0) {
+			error = "cannot resolve " + address;
+			return false;
+		}
+		for (addrinfo* a = found; a != nullptr && !is_open(); a = a->ai_next) {
+			handle = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+			if (!is_open())
+				continue;
+			bool ok;
+			if (server) {
+				int yes = 1;
+				setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+				ok = ::bind(handle, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0 && ::listen(handle, backlog) == 0;
+			}
+			else {
+				ok = ::connect(handle, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0;
+			}
+			if (!ok)
+				close();
+		}
+		freeaddrinfo(found);
+		if (!is_open()) {
+			error = std::string(server ? "cannot listen on " : "cannot connect to ") + address;
+			return false;
+		}
+		if (!server)
+			set_no_delay();
+		return true;
+	}
+
+	bool open_unix(const std::string& path, bool server, std::string& error) {
+#ifdef _WIN32
+		(void)server;
+		error = "unix:" + path + ": Unix-domain sockets are not supported on Windows, use host:port";
+		return false;
+#else
+		sockaddr_un a;
+		memset(&a, 0, sizeof(a));
+		a.sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof(a.sun_path)) {
+			error = "bad Unix socket path '" + path + "'";
+			return false;
+		}
+		memcpy(a.sun_path, path.c_str(), path.size());
+		handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		bool ok = is_open();
+		if (ok && server) {
+			unlink(path.c_str());
+			ok = ::bind(handle, reinterpret_cast<sockaddr*>(&a), sizeof(a)) == 0 && ::listen(handle, backlog) == 0;
+		}
+		else if (ok) {
+			ok = ::connect(handle, reinterpret_cast<sockaddr*>(&a), sizeof(a)) == 0;
+		}
+		if (!ok) {
+			close();
+			error = std::string(server ? "cannot listen on unix:" : "cannot connect to unix:") + path;
+		}
+		return ok;
+#endif
+	}
+
+	// Small messages (tile requests) go out at once instead of waiting for more.
+	void set_no_delay() {
+		if (!is_open())
+			return;
+		int yes = 1;
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+	}
+
+	static void startup() {
+#ifdef _WIN32
+		struct winsock
+		{
+			winsock() {
+				WSADATA data;
+				WSAStartup(MAKEWORD(2, 2), &data);
+			}
+			~winsock() {
+				WSACleanup();
+			}
+		};
+		static winsock instance;
+#endif
+	}
+
+private:
+	static const int backlog = 16;
+	native_handle handle = invalid_handle;
+};
+
+#endif
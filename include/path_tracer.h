@@ -0,0 +1,112 @@
+#pragma once
+#ifndef PATH_TRACER_H
+#define PATH_TRACER_H
+
+#include <rtweekend.h>
+#include <hittable.h>
+#include <render_stats.h>
+#include <sampler.h>
+#include <sampling.h>
+
+#include <algorithm>
+#include <atomic>
+
+// Path length tally shared by the render threads.
+struct path_stats
+{
+	std::atomic<long long> paths{ 0 };
+	std::atomic<long long> segments{ 0 };   // rays traced, camera ray included
+
+	void reset() {
+		paths = 0;
+		segments = 0;
+	}
+
+	void record(int path_segments) {
+		paths.fetch_add(1, std::memory_order_relaxed);
+		segments.fetch_add(path_segments, std::memory_order_relaxed);
+	}
+
+	double average_length() const {
+		long long n = paths;
+		return n > 0 ? double(segments) / n : 0.0;
+	}
+};
+
+// Sky gradient seen by rays that leave the scene.
+inline color background(const ray& r) {
+	vec3 unit_direction = unit_vector(r.direction());
+	real t = real(0.5) * (unit_direction.y() + 1);
+	return (1 - t) * color(1, 1, 1) + t * color(real(0.5), real(0.7), 1);
+}
+
+// Iterative diffuse path tracer.
+// Bounces are cosine-weighted about the normal (ideal Lambertian), one 2D
+// sample each, in closed form (sampling.h).
+// Throughput is carried in a loop instead of recursing once per bounce, and
+// after roulette_depth bounces a path survives each further bounce only with
+// probability max(throughput) (its throughput divided by that probability),
+// so dim paths stop early while the expected value stays the same.
+// max_depth still caps the number of rays, as the recursive version did.
+// Roulette and bounce directions draw from the thread's sampler (sampler.h).
+class path_tracer
+{
+public:
+	path_tracer(int max_depth, int roulette_depth = 3, path_stats* stats = nullptr)
+		: max_depth(max_depth), roulette_depth(roulette_depth), stats(stats) {}
+
+	color trace(const ray& r, const hittable& world) const {
+		hit_record rec;
+		bool hit = max_depth > 0 && world.hit(r, real(0.001), infinity, rec);
+		return trace_from_hit(r, hit, rec, world);
+	}
+
+	// trace() once the first hit along r is known (traced on its own or as part of a packet).
+	color trace_from_hit(const ray& r, bool hit, const hit_record& first, const hittable& world) const {
+		if (max_depth <= 0)
+			return color(0, 0, 0);
+
+		color throughput(1, 1, 1);
+		color radiance(0, 0, 0);
+		ray current = r;
+		hit_record rec = first;
+		int segments = 1;
+
+		while (true) {
+			if (!hit) {
+				radiance = throughput * background(current);
+				break;
+			}
+			if (segments >= max_depth)
+				break;
+
+			throughput = real(0.5) * throughput;
+			if (segments >= roulette_depth) {
+				real survive = std::min(real(0.95), std::max(throughput.x(), std::max(throughput.y(), throughput.z())));
+				if (sample_1d() >= survive)
+					break;
+				throughput = throughput / survive;
+			}
+
+			double u, v;
+			sample_2d(u, v);
+			current = ray(rec.p, sample_cosine_direction(rec.normal, u, v));
+			hit = world.hit(current, real(0.001), infinity, rec);
+			segments++;
+		}
+
+		if (stats != nullptr)
+			stats->record(segments);
+		RT_COUNT(paths);
+		RT_COUNT_N(rays, segments);
+		RT_COUNT_DEPTH(segments);
+		return radiance;
+	}
+
+private:
+	int max_depth;
+	int roulette_depth;
+	path_stats* stats;
+};
+
+#endif
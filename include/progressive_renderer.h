@@ -0,0 +1,281 @@
+#pragma once
+#ifndef PROGRESSIVE_RENDERER_H
+#define PROGRESSIVE_RENDERER_H
+
+#include <rtweekend.h>
+#include <hittable.h>
+#include <camera.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <wavefront.h>
+#include <sampler.h>
+#include <render_stats.h>
+#include <trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Progressive accumulation, shared by the viewer and the command-line renderer.
+// Each pass adds one sample per pixel to the accumulation buffer (and, if a
+// display buffer is set, resolves the pixel into it right away). Runs until
+// target_passes passes are done or the engine is cancelled; running it again
+// keeps refining the samples already in the buffer instead of starting over.
+// The buffer must already have the image size.
+//
+// In adaptive mode target_passes is a budget of target_passes samples per
+// pixel on average instead. Once a pixel has min_samples, it stops as soon as
+// the relative error of its mean (accumulation_buffer::relative_error) is
+// below target_error; passes go on over the remaining pixels, each capped at
+// max_samples, until the budget is spent or every pixel has stopped. Flat
+// pixels stop early and the samples they leave over go to the noisy ones.
+//
+// Every sample starts the thread's generator and sampler (sampler.h) for
+// its pixel and sample index; the callbacks draw from them.
+//
+// If checkpoint is set it is called between passes, when every pixel has
+// the samples its count says, at most once per checkpoint_seconds and after
+// the last pass; see checkpoint.h for saving the buffer from it.
+class progressive_renderer
+{
+public:
+	progressive_renderer(render_engine& engine, accumulation_buffer& accum) : engine(engine), accum(accum) {}
+
+	// sample(i, j) returns one sample of pixel (i, j), jittered with
+	// sample_2d().
+	template<typename Sample>
+	void accumulate(Sample sample) {
+		int width = accum.width();
+		run_passes([&] {
+			engine.render(width, accum.height(), [&](int i, int j) {
+				int index = i + j * width;
+				if (!is_active(index))
+					return;
+				begin_sample(i, j, index);
+				store(index, sample(i, j));
+			});
+		});
+	}
+
+	// Like accumulate, but the jittered primary rays of each
+	// packet_size x packet_size pixel block are traced together through
+	// world.hit_packet(); shade(r, hit, rec) then finishes every path from its
+	// primary hit with ordinary single rays.
+	template<typename Shade>
+	void accumulate_packets(const camera& cam, const hittable& world, Shade shade) {
+		int width = accum.width();
+		int height = accum.height();
+		run_passes([&] {
+			engine.render_tiles(width, height, [&](const tile& t) {
+				for (int by = t.y0; by < t.y1; by += packet_size) {
+					for (int bx = t.x0; bx < t.x1; bx += packet_size) {
+						int bx1 = std::min(bx + packet_size, t.x1);
+						int by1 = std::min(by + packet_size, t.y1);
+
+						ray_packet packet;
+						for (int j = by; j < by1; j++) {
+							for (int i = bx; i < bx1; i++) {
+								int index = i + j * width;
+								if (!is_active(index))
+									continue;
+								begin_sample(i, j, index);
+								double du, dv;
+								sample_2d(du, dv);
+								auto u = real((i + du) / (width - 1));
+								auto v = real((j + dv) / (height - 1));
+								packet.add(cam.get_ray(u, v));
+							}
+						}
+						if (packet.size == 0)
+							continue;
+						world.hit_packet(packet, real(0.001));
+
+						int k = 0;
+						for (int j = by; j < by1; j++) {
+							for (int i = bx; i < bx1; i++) {
+								int index = i + j * width;
+								if (!is_active(index))
+									continue;
+								// the camera jitter was the first dimension
+								begin_sample(i, j, index, 1, 1);
+								store(index, shade(packet.get(k), packet.hit[k], packet.rec[k]));
+								k++;
+							}
+						}
+					}
+				}
+			});
+		});
+	}
+
+	// Like accumulate with tracer's integrator, but the samples of each tile
+	// are traced as one wavefront batch (see wavefront.h). The image is the
+	// same as accumulate() tracing the same jittered camera rays with a
+	// path_tracer of the same settings. The camera rays are queued by
+	// packet_size x packet_size blocks, so the batch's packets of camera
+	// rays are square blocks rather than thin strips of a row.
+	void accumulate_wavefront(const camera& cam, const hittable& world, const wavefront_tracer& tracer) {
+		int width = accum.width();
+		int height = accum.height();
+		run_passes([&] {
+			engine.render_tiles(width, height, [&](const tile& t) {
+				static thread_local wavefront_batch batch;
+				// (i, j) of the tile's pixels, by blocks
+				auto for_each_pixel = [&](const tile& t, auto f) {
+					for (int by = t.y0; by < t.y1; by += packet_size) {
+						for (int bx = t.x0; bx < t.x1; bx += packet_size) {
+							for (int j = by; j < std::min(by + packet_size, t.y1); j++) {
+								for (int i = bx; i < std::min(bx + packet_size, t.x1); i++) {
+									f(i, j);
+								}
+							}
+						}
+					}
+				};
+				batch.clear();
+				{
+					RT_TRACE_ZONE("generate");
+					for_each_pixel(t, [&](int i, int j) {
+						int index = i + j * width;
+						if (!is_active(index))
+							return;
+						begin_sample(i, j, index);
+						double du, dv;
+						sample_2d(du, dv);
+						auto u = real((i + du) / (width - 1));
+						auto v = real((j + dv) / (height - 1));
+						batch.add(cam.get_ray(u, v));
+					});
+				}
+				tracer.trace(batch, world);
+
+				RT_TRACE_ZONE("accumulate");
+				int k = 0;
+				for_each_pixel(t, [&](int i, int j) {
+					int index = i + j * width;
+					if (is_active(index))
+						store(index, batch.radiance[k++]);
+				});
+			});
+		});
+	}
+
+public:
+	int target_passes = 0;
+	int seed = 0;
+	uint8_t* display = nullptr;     // RGBA8 view of the buffer, or null
+	bool fix_gamma = false;
+	int packet_size = 8;            // 8x8 = ray_packet::max_size
+	sampler_type sampler = sampler_type::independent;
+
+	bool adaptive = false;
+	double target_error = 0.02;
+	int min_samples = 16;
+	int max_samples = 0;            // 0 for 8 x target_passes
+
+	std::function<void()> checkpoint;
+	double checkpoint_seconds = 60;
+
+	// Pixels still being sampled after the last pass (all of them when not adaptive).
+	int active_pixels() const { return active_count; }
+
+private:
+	template<typename RenderPass>
+	void run_passes(RenderPass render_pass) {
+		active_count = accum.width() * accum.height();
+		last_checkpoint = std::chrono::steady_clock::now();
+		bool unsaved = false;
+		if (!adaptive) {
+			active.clear();
+			while (accum.passes() < target_passes && !engine.is_cancelled()) {
+				if (finish_pass(render_pass))
+					unsaved = !checkpoint_due(false);
+			}
+		}
+		else {
+			long long budget = (long long)target_passes * accum.width() * accum.height();
+			while (!engine.is_cancelled() && accum.total_samples() < budget && update_active() > 0) {
+				if (finish_pass(render_pass))
+					unsaved = !checkpoint_due(false);
+			}
+			update_active();
+		}
+		// after a cancel the buffer holds part of a pass, which is not saved:
+		// resuming redoes the passes since the last checkpoint
+		if (unsaved && !engine.is_cancelled())
+			checkpoint_due(true);
+	}
+
+	// Runs one pass and, unless it was cancelled, adds it to the buffer and
+	// its wall time to render_stats. Returns whether the pass completed.
+	template<typename RenderPass>
+	bool finish_pass(RenderPass& render_pass) {
+		RT_TRACE_ZONE("pass");
+		auto start = std::chrono::steady_clock::now();
+		render_pass();
+		if (engine.is_cancelled())
+			return false;
+		accum.end_pass();
+		std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		render_stats::global().end_pass(seconds.count());
+		return true;
+	}
+
+	// Calls checkpoint if it is set and its interval is up (or force).
+	// Returns whether it was called.
+	bool checkpoint_due(bool force) {
+		if (!checkpoint)
+			return false;
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - last_checkpoint;
+		if (!force && elapsed.count() < checkpoint_seconds)
+			return false;
+		RT_TRACE_ZONE("checkpoint");
+		checkpoint();
+		last_checkpoint = std::chrono::steady_clock::now();
+		return true;
+	}
+
+	// Marks the pixels the next adaptive pass samples, returns how many.
+	int update_active() {
+		RT_TRACE_ZONE("update active");
+		int cap = max_samples > 0 ? max_samples : 8 * target_passes;
+		int pixels = accum.width() * accum.height();
+		active.resize(pixels);
+		active_count = 0;
+		for (int index = 0; index < pixels; index++) {
+			int n = accum.sample_count(index);
+			bool sampling = n < std::min(min_samples, cap) || (n < cap && accum.relative_error(index) > target_error);
+			active[index] = sampling ? 1 : 0;
+			active_count += sampling ? 1 : 0;
+		}
+		return active_count;
+	}
+
+	// Seeds the thread's generator (stream) and sampler for the pixel's next sample.
+	void begin_sample(int i, int j, int index, uint64_t stream = 0, uint32_t dimension = 0) {
+		int n = accum.sample_count(index);
+		seed_pixel_rng(seed, index, n, stream);
+		start_pixel_sample(sampler, seed, i, j, index, n, target_passes, dimension);
+	}
+
+	bool is_active(int index) const {
+		return active.empty() || active[index] != 0;
+	}
+
+	void store(int index, const color& c) {
+		accum.add_sample(index, c);
+		if (display != nullptr)
+			accum.resolve_pixel(index, display, fix_gamma);
+	}
+
+private:
+	render_engine& engine;
+	accumulation_buffer& accum;
+	std::vector<uint8_t> active;    // per pixel, empty when not adaptive
+	int active_count = 0;
+	std::chrono::steady_clock::time_point last_checkpoint;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#pragma once
+#ifndef RENDER_ENGINE_H
+#define RENDER_ENGINE_H
+
+#include <thread_pool.h>
+#include <render_stats.h>
+#include <trace.h>
+#include <space_filling.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// A rectangular block of the framebuffer, [x0, x1) x [y0, y1).
+struct tile
+{
+	int x0, y0;
+	int x1, y1;
+};
+
+// The tiles covering the image, in the given order of the tile grid.
+inline std::vector<tile> make_tiles(int width, int height, int tile_size, pixel_order order = pixel_order::row_major) {
+	std::vector<tile> tiles;
+	std::vector<uint32_t> keys;
+	int columns = (width + tile_size - 1) / tile_size;
+	int rows = (height + tile_size - 1) / tile_size;
+	uint32_t side = next_power_of_two(uint32_t(std::max(columns, rows)));
+	for (int y = 0; y < height; y += tile_size) {
+		for (int x = 0; x < width; x += tile_size) {
+			tiles.push_back({ x, y, std::min(x + tile_size, width), std::min(y + tile_size, height) });
+			keys.push_back(curve_index(order, side, uint32_t(x / tile_size), uint32_t(y / tile_size)));
+		}
+	}
+	if (order != pixel_order::row_major) {
+		std::vector<int> sorted(tiles.size());
+		for (size_t k = 0; k < sorted.size(); k++) {
+			sorted[k] = int(k);
+		}
+		std::sort(sorted.begin(), sorted.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+		std::vector<tile> ordered;
+		for (int k : sorted) {
+			ordered.push_back(tiles[k]);
+		}
+		tiles.swap(ordered);
+	}
+	return tiles;
+}
+
+// Splits the image into tiles and shades them on a work-stealing thread pool.
+// The per-pixel callback gets (i, j) exactly as the old nested loops did and
+// must only write to its own pixel. order sets the order tiles are queued
+// in and the order render() visits the pixels of a tile (see
+// space_filling.h); it does not change the image.
+// progress() and cancel() may be called from any thread while render() runs;
+// a cancelled engine skips every tile that has not started yet until resume().
+// tile_done, if set, is called on the rendering thread after each finished tile.
+// Each tile also flushes the render_stats counters of the thread it ran on.
+class render_engine
+{
+public:
+	explicit render_engine(int thread_count = 0) {
+		set_thread_count(thread_count);
+	}
+
+	int thread_count() const {
+		return pool->size();
+	}
+
+	// Rebuilds the pool only when the count actually changes; <= 0 means one per core.
+	void set_thread_count(int n) {
+		if (n <= 0)
+			n = thread_pool::default_thread_count();
+		if (pool == nullptr || pool->size() != n)
+			pool.reset(new thread_pool(n));
+	}
+
+	template<typename Shade>
+	void render(int width, int height, Shade shade_pixel) {
+		if (order == pixel_order::row_major) {
+			render_tiles(width, height, [&shade_pixel](const tile& t) {
+				for (int j = t.y0; j < t.y1; j++) {
+					for (int i = t.x0; i < t.x1; i++) {
+						shade_pixel(i, j);
+					}
+				}
+			});
+			return;
+		}
+		// edge tiles skip the cells of the padded square that fall outside
+		uint32_t side = next_power_of_two(uint32_t(tile_size));
+		if (cells.empty() || cells_order != order || cells_side != side) {
+			cells = curve_cells(order, side);
+			cells_order = order;
+			cells_side = side;
+		}
+		render_tiles(width, height, [this, &shade_pixel](const tile& t) {
+			for (const curve_cell& c : cells) {
+				int i = t.x0 + c.x;
+				int j = t.y0 + c.y;
+				if (i < t.x1 && j < t.y1)
+					shade_pixel(i, j);
+			}
+		});
+	}
+
+	// Same scheduling, but the callback gets a whole tile, for renderers that
+	// work on blocks of pixels at once.
+	template<typename ShadeTile>
+	void render_tiles(int width, int height, ShadeTile shade_tile) {
+		RT_TRACE_ZONE("render");
+		std::vector<tile> tiles = make_tiles(width, height, tile_size, order);
+		tiles_done = 0;
+		tiles_total = static_cast<int>(tiles.size());
+
+		for (const tile& t : tiles) {
+			pool->submit([this, t, &shade_tile] {
+				if (cancelled)
+					return;
+				RT_TRACE_ZONE("tile");
+				shade_tile(t);
+				flush_thread_stats();
+				if (tile_done)
+					tile_done(t);
+				tiles_done++;
+			});
+		}
+		pool->wait();
+	}
+
+	// Fraction of the tiles of the current (or last) render() that are finished.
+	float progress() const {
+		int total = tiles_total;
+		return total > 0 ? float(tiles_done) / total : 0.0f;
+	}
+
+	void cancel() {
+		cancelled = true;
+	}
+
+	void resume() {
+		cancelled = false;
+	}
+
+	bool is_cancelled() const {
+		return cancelled;
+	}
+
+public:
+	int tile_size = 32;
+	pixel_order order = pixel_order::row_major;
+	std::function<void(const tile&)> tile_done;
+
+private:
+	std::unique_ptr<thread_pool> pool;
+	std::vector<curve_cell> cells;  // in-tile visiting order, for render()
+	pixel_order cells_order = pixel_order::row_major;
+	uint32_t cells_side = 0;
+
+	std::atomic<int> tiles_done{ 0 };
+	std::atomic<int> tiles_total{ 0 };
+	std::atomic<bool> cancelled{ false };
+};
+
+#endif
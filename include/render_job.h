@@ -0,0 +1,70 @@
+#pragma once
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include <render_engine.h>
+#include <trace.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// Runs a render on a background thread so the UI loop keeps presenting.
+// The work function drives the engine as usual; the UI polls running(),
+// progress() and may cancel() at any time.
+class render_job
+{
+public:
+	explicit render_job(render_engine& e) : engine(e) {}
+
+	~render_job() {
+		cancel();
+		wait();
+	}
+
+	render_job(const render_job&) = delete;
+	render_job& operator=(const render_job&) = delete;
+
+	// Cancels and joins any job still in flight before starting the new one.
+	void start(std::function<void()> work) {
+		cancel();
+		wait();
+
+		engine.resume();
+		active = true;
+		worker = std::thread([this, work] {
+			RT_TRACE_THREAD("render job");
+			work();
+			active = false;
+		});
+	}
+
+	void cancel() {
+		if (active)
+			engine.cancel();
+	}
+
+	void wait() {
+		if (worker.joinable())
+			worker.join();
+	}
+
+	bool running() const {
+		return active;
+	}
+
+	bool cancelled() const {
+		return engine.is_cancelled();
+	}
+
+	float progress() const {
+		return engine.progress();
+	}
+
+private:
+	render_engine& engine;
+	std::thread worker;
+	std::atomic<bool> active{ false };
+};
+
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+// Render statistics: what the rays of a render cost.
+// Counting sites bump plain counters of the calling thread (RT_COUNT), which
+// render_engine adds into the shared totals once per finished tile
+// (flush_thread_stats), so the hot paths never touch a shared cache line.
+// Defining RT_NO_STATS compiles every counting site out.
+
+struct render_counters
+{
+	static const int depth_buckets = 16;
+
+	uint64_t rays;              // camera rays and bounces traced
+	uint64_t paths;             // camera samples finished by the path tracer
+	uint64_t sphere_tests;      // ray-sphere intersections computed, SIMD lanes included
+	uint64_t list_hits;         // hittable_list::hit calls
+	uint64_t bvh_nodes;         // bvh nodes whose box was tested
+	uint64_t depth[depth_buckets];  // paths by rays traced: 1, 2, ... depth_buckets or more
+
+	void add(const render_counters& other) {
+		rays += other.rays;
+		paths += other.paths;
+		sphere_tests += other.sphere_tests;
+		list_hits += other.list_hits;
+		bvh_nodes += other.bvh_nodes;
+		for (int k = 0; k < depth_buckets; k++) {
+			depth[k] += other.depth[k];
+		}
+	}
+};
+
+// Counters of the calling thread. Zero-initialized POD, so access needs no
+// guard for dynamic initialization.
+inline render_counters& thread_stats() {
+	static thread_local render_counters counters;
+	return counters;
+}
+
+#ifdef RT_NO_STATS
+#define RT_COUNT(field) ((void)0)
+#define RT_COUNT_N(field, n) ((void)0)
+#define RT_COUNT_DEPTH(rays) ((void)0)
+#else
+#define RT_COUNT(field) (thread_stats().field++)
+#define RT_COUNT_N(field, n) (thread_stats().field += uint64_t(n))
+#define RT_COUNT_DEPTH(rays) (thread_stats().depth[(rays) < render_counters::depth_buckets ? (rays) - 1 : render_counters::depth_buckets - 1]++)
+#endif
+
+// Totals over every thread, and the time spent in render passes.
+class render_stats
+{
+public:
+	static render_stats& global() {
+		static render_stats stats;
+		return stats;
+	}
+
+	// Adds the calling thread's counters to the totals and zeroes them.
+	void flush(render_counters& counters) {
+		std::lock_guard<std::mutex> lock(mutex);
+		totals.add(counters);
+		memset(&counters, 0, sizeof(counters));
+	}
+
+	// Called when a pass is done (its tiles flushed) with its wall time.
+	void end_pass(double seconds) {
+		std::lock_guard<std::mutex> lock(mutex);
+		passes++;
+		pass_seconds += seconds;
+		last_pass_seconds = seconds;
+		last_pass_rays = totals.rays - rays_before_pass;
+		rays_before_pass = totals.rays;
+	}
+
+	void reset() {
+		std::lock_guard<std::mutex> lock(mutex);
+		memset(&totals, 0, sizeof(totals));
+		passes = 0;
+		pass_seconds = 0;
+		last_pass_seconds = 0;
+		last_pass_rays = 0;
+		rays_before_pass = 0;
+	}
+
+	struct snapshot
+	{
+		render_counters totals;
+		int passes;
+		double pass_seconds;        // summed over the passes
+		double last_pass_seconds;
+		uint64_t last_pass_rays;
+
+		double rays_per_second() const {
+			return pass_seconds > 0 ? totals.rays / pass_seconds : 0;
+		}
+
+		double per_ray(uint64_t count) const {
+			return totals.rays > 0 ? double(count) / totals.rays : 0;
+		}
+	};
+
+	snapshot read() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return { totals, passes, pass_seconds, last_pass_seconds, last_pass_rays };
+	}
+
+private:
+	render_stats() {
+		memset(&totals, 0, sizeof(totals));
+	}
+
+	mutable std::mutex mutex;
+	render_counters totals;
+	int passes = 0;
+	double pass_seconds = 0;
+	double last_pass_seconds = 0;
+	uint64_t last_pass_rays = 0;
+	uint64_t rays_before_pass = 0;
+};
+
+// Hands the calling thread's counters to render_stats::global().
+inline void flush_thread_stats() {
+#ifndef RT_NO_STATS
+	render_stats::global().flush(thread_stats());
+#endif
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// PCG32 (XSH-RR variant, O'Neill 2014): 64-bit state, 32-bit output, cheap
+// to seed and copy, good statistical quality. Each stream (the odd inc) is
+// an independent sequence.
+class pcg32
+{
+public:
+    pcg32() { seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL); }
+    pcg32(uint64_t initstate, uint64_t initseq) { seed(initstate, initseq); }
+
+    void seed(uint64_t initstate, uint64_t initseq) {
+        state = 0;
+        inc = (initseq << 1u) | 1u;
+        next_uint();
+        state += initstate;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t oldstate = state;
+        state = oldstate * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((oldstate >> 18u) ^ oldstate) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(oldstate >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // Uniform in [0, 1).
+    double next_double() {
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+public:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// SplitMix64 finalizer, used to turn (seed, pixel, sample) into well spread
+// generator states.
+inline uint64_t mix_bits(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// The generator behind random_double() on the calling thread.
+inline pcg32& thread_rng() {
+    static thread_local pcg32 generator;
+    return generator;
+}
+
+// Reseeds the calling thread's generator for one sample of one pixel, so an
+// image depends only on the render seed and not on which thread happened to
+// render which tile. stream separates independent uses within one sample.
+inline void seed_pixel_rng(uint64_t render_seed, uint64_t pixel, uint64_t sample, uint64_t stream = 0) {
+    thread_rng().seed(mix_bits(render_seed ^ mix_bits(pixel ^ mix_bits(sample))), stream);
+}
+
+#endif
@@ -6,17 +6,26 @@
 #include <limits>
 #include <memory>
 #include <cstdlib>
-#include <random>
 #include<iostream>
 
+#include "rng.h"
+
 // Usings
 using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
 
+// Scalar of vec3, ray and the intersection code. Double by default; define
+// RT_USE_FLOAT to build the whole render path in single precision.
+#ifdef RT_USE_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
+const real infinity = std::numeric_limits<real>::infinity();
 const double pi = 3.1415926535897932385;
 
 // Utility Functions
@@ -25,14 +34,14 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+// Both draw from the calling thread's pcg32 (see rng.h), so they are safe
+// to call from the render threads and reproducible with seed_pixel_rng().
 inline double random_double() {
-    return rand() / (RAND_MAX + 1.0);
+    return thread_rng().next_double();
 }
 
 inline double random_double2() {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
+    return thread_rng().next_double();
 }
 
 inline double random_double(double min, double max) {
@@ -0,0 +1,332 @@
+#pragma once
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <rtweekend.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Where the random numbers of one pixel sample come from.
+//
+//     independent  the thread's pcg32 (rng.h), as random_double() draws
+//     stratified   per dimension a random permutation of the pixel's
+//                  samples over equal strata, jittered; 2D dimensions are
+//                  correlated multi-jittered (Kensler 2013)
+//     sobol        the first two Sobol dimensions, Owen-scrambled and index
+//                  shuffled per pixel and dimension with hashes (Burley,
+//                  "Practical Hash-based Owen Scrambling", 2020)
+//     blue_noise   a rank-1 lattice over the samples (golden ratio in 1D,
+//                  R2 in 2D), offset per pixel by a 64x64 void-and-cluster
+//                  mask tiled over the image (shifted per dimension), so
+//                  neighbouring pixels get dissimilar offsets and the error
+//                  is high-frequency at every sample count
+//
+// A sample draws its dimensions in a fixed order, each sample_1d() or
+// sample_2d() call taking the next one: the camera jitter first, then per
+// bounce the roulette test and the bounce direction. Since a path's depth
+// decides which of those it takes, dimension k means the same thing in
+// every path. start_pixel_sample() selects the sampler for the calling
+// thread's next sample; like seed_pixel_rng() it depends only on (seed,
+// pixel, sample index), never on the thread.
+enum class sampler_type { independent, stratified, sobol, blue_noise };
+
+inline const char* sampler_name(sampler_type type) {
+	switch (type) {
+	case sampler_type::stratified:
+		return "stratified";
+	case sampler_type::sobol:
+		return "sobol";
+	case sampler_type::blue_noise:
+		return "bluenoise";
+	default:
+		return "independent";
+	}
+}
+
+// The state of the sample being taken on a thread.
+struct pixel_sample
+{
+	sampler_type type;
+	uint32_t seed;
+	uint32_t pixel;             // row-major index
+	uint32_t x, y;
+	uint32_t index;             // sample number within the pixel
+	uint32_t count;             // samples per pixel the strata are made for
+	uint32_t dimension;         // next dimension to draw
+};
+
+// Zero-initialized POD: the independent sampler until a start_pixel_sample().
+inline pixel_sample& thread_sample() {
+	static thread_local pixel_sample sample;
+	return sample;
+}
+
+// Starts sample `index` of pixel (x, y) on the calling thread. count is the
+// number of samples the stratified sampler divides each dimension for;
+// later samples start another set of strata. Seed the thread's generator
+// as well (seed_pixel_rng), which the independent sampler draws from.
+inline void start_pixel_sample(sampler_type type, uint64_t seed, int x, int y, int pixel, int index, int count, uint32_t dimension = 0) {
+	pixel_sample& s = thread_sample();
+	s.type = type;
+	s.seed = uint32_t(mix_bits(seed));
+	s.pixel = uint32_t(pixel);
+	s.x = uint32_t(x);
+	s.y = uint32_t(y);
+	s.index = uint32_t(index);
+	s.count = uint32_t(std::max(count, 1));
+	s.dimension = dimension;
+}
+
+inline uint32_t hash_sample(uint32_t a, uint32_t b, uint32_t c = 0) {
+	return uint32_t(mix_bits((uint64_t(a) << 32 | b) ^ mix_bits(c)));
+}
+
+inline double to_unit(uint32_t bits) {
+	return std::min(bits * (1.0 / 4294967296.0), 1.0 - 1e-16);
+}
+
+// Kensler's hashed permutation of [0, l): permute(i, l, p) for i < l is
+// a bijection, a different one for every p.
+inline uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+	uint32_t w = l - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+	do {
+		i ^= p;
+		i *= 0xe170893d;
+		i ^= p >> 16;
+		i ^= (i & w) >> 4;
+		i ^= p >> 8;
+		i *= 0x0929eb3f;
+		i ^= p >> 23;
+		i ^= (i & w) >> 1;
+		i *= 1 | p >> 27;
+		i *= 0x6935fa69;
+		i ^= (i & w) >> 11;
+		i *= 0x74dcb303;
+		i ^= (i & w) >> 2;
+		i *= 0x9e501cc3;
+		i ^= (i & w) >> 2;
+		i *= 0xc860a3df;
+		i &= w;
+		i ^= i >> 5;
+	} while (i >= l);
+	return (i + p) % l;
+}
+
+inline double hashed_jitter(uint32_t i, uint32_t p) {
+	i ^= p;
+	i ^= i >> 17;
+	i ^= i >> 10;
+	i *= 0xb36534e5;
+	i ^= i >> 12;
+	i ^= i >> 21;
+	i *= 0x93fc4795;
+	i ^= 0xdf6e307f;
+	i ^= i >> 17;
+	i *= 1 | p >> 18;
+	return to_unit(i);
+}
+
+inline uint32_t reverse_bits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+	x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+	x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+	x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+	return x;
+}
+
+// Owen scrambling of a 32-bit fixed-point value: each bit is flipped
+// depending on the bits above it (Laine-Karras hash on the reversed bits).
+inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+	x = reverse_bits(x);
+	x += seed;
+	x ^= x * 0x6c50b47c;
+	x ^= x * 0xb82f1e52;
+	x ^= x * 0xc7afe638;
+	x ^= x * 0x8d22f6e6;
+	return reverse_bits(x);
+}
+
+// Second Sobol dimension (the first is the bit reversal of the index).
+inline uint32_t sobol_dimension_1(uint32_t index) {
+	uint32_t result = 0;
+	for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+		if (index & 1)
+			result ^= v;
+	}
+	return result;
+}
+
+// 64x64 blue-noise ranks (0 to 4095) by void and cluster (Ulichney 1993),
+// built on first use: points are added one at a time where the Gaussian
+// energy of those already placed is lowest, after an initial set has been
+// relaxed and ranked by removing the tightest cluster first.
+inline const std::vector<uint16_t>& blue_noise_mask() {
+	static const std::vector<uint16_t> mask = [] {
+		const int size = 64;
+		const int n = size * size;
+		const double sigma = 1.5;
+		// toroidal Gaussian by offset
+		std::vector<float> kernel(n);
+		for (int dy = 0; dy < size; dy++) {
+			for (int dx = 0; dx < size; dx++) {
+				int ox = std::min(dx, size - dx);
+				int oy = std::min(dy, size - dy);
+				kernel[dy * size + dx] = float(std::exp(-(ox * ox + oy * oy) / (2 * sigma * sigma)));
+			}
+		}
+		std::vector<uint8_t> on(n, 0);
+		std::vector<float> energy(n, 0.0f);
+		auto splat = [&](int p, float sign) {
+			int px = p % size, py = p / size;
+			for (int y = 0; y < size; y++) {
+				const float* row = &kernel[((y - py + size) % size) * size];
+				float* e = &energy[y * size];
+				for (int x = 0; x < size; x++) {
+					e[x] += sign * row[(x - px + size) % size];
+				}
+			}
+		};
+		// tightest cluster among the points that are on, or largest void among those that are off
+		auto extreme = [&](bool cluster) {
+			int best = -1;
+			for (int p = 0; p < n; p++) {
+				if ((on[p] != 0) != cluster)
+					continue;
+				if (best < 0 || (cluster ? energy[p] > energy[best] : energy[p] < energy[best]))
+					best = p;
+			}
+			return best;
+		};
+
+		// initial pattern: a tenth of the pixels at random, relaxed
+		pcg32 rng(0x2545f4914f6cdd1dULL, 7);
+		int initial = n / 10;
+		for (int placed = 0; placed < initial;) {
+			int p = int(rng.next_uint() % uint32_t(n));
+			if (on[p] == 0) {
+				on[p] = 1;
+				splat(p, 1);
+				placed++;
+			}
+		}
+		for (int iteration = 0; iteration < n; iteration++) {
+			int cluster = extreme(true);
+			on[cluster] = 0;
+			splat(cluster, -1);
+			int void_ = extreme(false);
+			on[void_] = 1;
+			splat(void_, 1);
+			if (void_ == cluster)
+				break;
+		}
+
+		std::vector<uint16_t> ranks(n);
+		std::vector<uint8_t> start = on;
+		std::vector<float> start_energy = energy;
+		for (int rank = initial - 1; rank >= 0; rank--) {
+			int cluster = extreme(true);
+			on[cluster] = 0;
+			splat(cluster, -1);
+			ranks[cluster] = uint16_t(rank);
+		}
+		on = start;
+		energy = start_energy;
+		for (int rank = initial; rank < n; rank++) {
+			int void_ = extreme(false);
+			on[void_] = 1;
+			splat(void_, 1);
+			ranks[void_] = uint16_t(rank);
+		}
+		return ranks;
+	}();
+	return mask;
+}
+
+// The next dimension of the thread's sample, in [0, 1).
+inline double sample_1d() {
+	pixel_sample& s = thread_sample();
+	if (s.type == sampler_type::independent)
+		return random_double();
+	uint32_t d = s.dimension++;
+	uint32_t h = hash_sample(s.seed ^ d, s.pixel);
+	switch (s.type) {
+	case sampler_type::stratified: {
+		uint32_t round = s.index / s.count;
+		uint32_t p = hash_sample(h, round);
+		uint32_t stratum = permute(s.index % s.count, s.count, p);
+		return (stratum + hashed_jitter(s.index, p * 0x68bc21eb)) / s.count;
+	}
+	case sampler_type::sobol: {
+		uint32_t i = owen_scramble(s.index, h);
+		return to_unit(owen_scramble(reverse_bits(i), h * 0x9e3779b9 + 1));
+	}
+	default: {
+		// one toroidal shift of the mask per dimension, the same for every
+		// pixel, so neighbouring pixels read neighbouring texels
+		const std::vector<uint16_t>& mask = blue_noise_mask();
+		uint32_t shift = hash_sample(s.seed ^ d, 0);
+		uint32_t ox = (s.x + shift) & 63, oy = (s.y + (shift >> 6)) & 63;
+		double offset = (mask[oy * 64 + ox] + 0.5) / 4096;
+		double value = offset + s.index * 0.6180339887498949;
+		return std::min(value - std::floor(value), 1.0 - 1e-16);
+	}
+	}
+}
+
+// The next two dimensions of the thread's sample, as one 2D dimension.
+inline void sample_2d(double& u, double& v) {
+	pixel_sample& s = thread_sample();
+	if (s.type == sampler_type::independent) {
+		u = random_double();
+		v = random_double();
+		return;
+	}
+	uint32_t d = s.dimension++;
+	uint32_t h = hash_sample(s.seed ^ d, s.pixel, 2);
+	switch (s.type) {
+	case sampler_type::stratified: {
+		// m x n strata for count samples, each sample alone in its row and column of substrata
+		uint32_t round = s.index / s.count;
+		uint32_t p = hash_sample(h, round);
+		uint32_t count = s.count;
+		uint32_t m = std::max(1u, uint32_t(std::sqrt(double(count))));
+		uint32_t n = (count + m - 1) / m;
+		uint32_t k = permute(s.index % count, count, p * 0x51633e2d);
+		uint32_t sx = permute(k % m, m, p * 0x68bc21eb);
+		uint32_t sy = permute(k / m, n, p * 0x02e5be93);
+		double jx = hashed_jitter(k, p * 0x967a889b);
+		double jy = hashed_jitter(k, p * 0x368cc8b7);
+		u = std::min((sx + (sy + jx) / n) / m, 1.0 - 1e-16);
+		v = std::min((k + jy) / count, 1.0 - 1e-16);
+		return;
+	}
+	case sampler_type::sobol: {
+		uint32_t i = owen_scramble(s.index, h);
+		u = to_unit(owen_scramble(reverse_bits(i), h * 0x9e3779b9 + 1));
+		v = to_unit(owen_scramble(sobol_dimension_1(i), h * 0x85ebca6b + 2));
+		return;
+	}
+	default: {
+		const std::vector<uint16_t>& mask = blue_noise_mask();
+		uint32_t shift = hash_sample(s.seed ^ d, 0, 2);
+		uint32_t ox = (s.x + shift) & 63, oy = (s.y + (shift >> 6)) & 63;
+		uint32_t ox2 = (s.x + (shift >> 12)) & 63, oy2 = (s.y + (shift >> 18)) & 63;
+		double a = (mask[oy * 64 + ox] + 0.5) / 4096 + s.index * 0.7548776662466927;
+		double b = (mask[oy2 * 64 + ox2] + 0.5) / 4096 + s.index * 0.5698402909980532;
+		u = std::min(a - std::floor(a), 1.0 - 1e-16);
+		v = std::min(b - std::floor(b), 1.0 - 1e-16);
+		return;
+	}
+	}
+}
+
+#endif
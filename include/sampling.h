@@ -0,0 +1,63 @@
+#pragma once
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <rtweekend.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Warps from the unit square to the shapes a renderer samples, in closed
+// form: each takes a 2D sample (u, v) in [0, 1)^2, e.g. from sample_2d()
+// (sampler.h), and costs a fixed handful of operations, with no rejection
+// loop and no data-dependent branch (the selects compile to conditional
+// moves). Stratified or low-discrepancy (u, v) stay well spread on the
+// shape, which a rejection loop would not preserve.
+
+// Uniform on the unit sphere: z uniform in [-1, 1] (Archimedes), angle
+// uniform around it.
+inline vec3 sample_uniform_sphere(double u, double v) {
+	double z = 1 - 2 * u;
+	double r = std::sqrt(std::max(0.0, 1 - z * z));
+	double phi = 2 * pi * v;
+	return vec3(real(r * std::cos(phi)), real(r * std::sin(phi)), real(z));
+}
+
+// Uniform on the unit disk in the xy plane, by polar coordinates.
+inline vec3 sample_uniform_disk(double u, double v) {
+	double r = std::sqrt(u);
+	double phi = 2 * pi * v;
+	return vec3(real(r * std::cos(phi)), real(r * std::sin(phi)), 0);
+}
+
+// Uniform on the unit disk by Shirley and Chiu's concentric map: squares
+// around the centre go to circles, so neighbouring samples stay neighbours
+// and strata keep their shape (for lens sampling).
+inline vec3 sample_concentric_disk(double u, double v) {
+	double a = 2 * u - 1;
+	double b = 2 * v - 1;
+	bool wide = std::abs(a) > std::abs(b);
+	double r = wide ? a : b;
+	double ratio = wide ? b / a : (b != 0 ? a / b : 0);
+	double theta = wide ? (pi / 4) * ratio : (pi / 2) - (pi / 4) * ratio;
+	return vec3(real(r * std::cos(theta)), real(r * std::sin(theta)), 0);
+}
+
+// Cosine-weighted over the hemisphere around +z (Malley's method: a point
+// of the concentric disk lifted onto the hemisphere). pdf = cos(theta) / pi.
+inline vec3 sample_cosine_hemisphere(double u, double v) {
+	vec3 d = sample_concentric_disk(u, v);
+	double z = std::sqrt(std::max(0.0, 1.0 - d.x() * d.x() - d.y() * d.y()));
+	return vec3(d.x(), d.y(), real(z));
+}
+
+// Cosine-weighted around the unit vector normal, without building a frame:
+// the normal plus a uniform point of the unit sphere is distributed as
+// cos(theta) about it (unnormalized). The rare direction that cancels
+// the normal falls back to the normal itself.
+inline vec3 sample_cosine_direction(const vec3& normal, double u, double v) {
+	vec3 d = normal + sample_uniform_sphere(u, v);
+	return d.length_squared() > real(1e-12) ? d : normal;
+}
+
+#endif
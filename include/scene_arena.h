@@ -0,0 +1,132 @@
+#pragma once
+#ifndef SCENE_ARENA_H
+#define SCENE_ARENA_H
+
+#include <rtweekend.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump allocator for scene objects.
+// make<T>() constructs objects back to back in large blocks instead of one
+// heap allocation each, so a scene built from it is contiguous in memory and
+// building a million spheres costs a few dozen allocations. The returned
+// shared_ptrs all share one control block owned by the arena: no per-object
+// control block or refcount. clear() releases everything at once; storage
+// still referenced by a handed-out pointer lives until that pointer goes.
+class scene_arena
+{
+public:
+	explicit scene_arena(size_t block_size = size_t(1) << 20) : block_size(block_size), store(std::make_shared<storage>()) {}
+
+	scene_arena(const scene_arena&) = delete;
+	scene_arena& operator=(const scene_arena&) = delete;
+
+	template<typename T, typename... Args>
+	shared_ptr<T> make(Args&&... args) {
+		// each object is stored right after the function that destroys it,
+		// so the storage can walk its blocks instead of keeping a list
+		block& b = block_for(alignof(destroy_fn) - 1 + sizeof(destroy_fn) + alignof(T) - 1 + sizeof(T));
+		char* header = b.data.get() + align_up(b.used, alignof(destroy_fn));
+		T* object = new (object_after<T>(header)) T(std::forward<Args>(args)...);
+		*reinterpret_cast<destroy_fn*>(header) = &destroy<T>;
+		b.used = size_t(reinterpret_cast<char*>(object + 1) - b.data.get());
+		store->objects++;
+		// aliasing constructor: owned by the arena's storage, points at object
+		return shared_ptr<T>(store, object);
+	}
+
+	// Drops the arena's objects; they are destroyed and their blocks freed
+	// as soon as no pointer from make() is left.
+	void clear() {
+		store = std::make_shared<storage>();
+	}
+
+	size_t object_count() const {
+		return store->objects;
+	}
+
+	// Bytes of the blocks, and of them the bytes holding objects.
+	size_t bytes_reserved() const {
+		size_t total = 0;
+		for (const block& b : store->blocks) {
+			total += b.size;
+		}
+		return total;
+	}
+
+	size_t bytes_used() const {
+		size_t total = 0;
+		for (const block& b : store->blocks) {
+			total += b.used;
+		}
+		return total;
+	}
+
+private:
+	// Destroys the object stored after the header and returns the end of it.
+	using destroy_fn = size_t (*)(char* header);
+
+	template<typename T>
+	static size_t destroy(char* header) {
+		T* object = reinterpret_cast<T*>(object_after<T>(header));
+		object->~T();
+		return size_t(reinterpret_cast<char*>(object + 1) - header);
+	}
+
+	// Where the object of the header goes: the first address after it
+	// aligned for T. Aligned by address, since new[] only guarantees
+	// alignment for fundamental types, not for an over-aligned T.
+	template<typename T>
+	static char* object_after(char* header) {
+		uintptr_t address = reinterpret_cast<uintptr_t>(header + sizeof(destroy_fn));
+		return header + sizeof(destroy_fn) + (align_up(address, alignof(T)) - address);
+	}
+
+	static size_t align_up(size_t offset, size_t alignment) {
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	struct block {
+		std::unique_ptr<char[]> data;
+		size_t size;
+		size_t used;
+	};
+
+	struct storage {
+		std::vector<block> blocks;
+		size_t objects = 0;
+
+		~storage() {
+			for (block& b : blocks) {
+				size_t offset = 0;
+				while (offset < b.used) {
+					offset = align_up(offset, alignof(destroy_fn));
+					char* header = b.data.get() + offset;
+					offset += (*reinterpret_cast<destroy_fn*>(header))(header);
+				}
+			}
+		}
+	};
+
+	// A block with at least size bytes left (a new one if the last is full).
+	// new[] storage is aligned for destroy_fn, like the header offsets.
+	block& block_for(size_t size) {
+		if (store->blocks.empty() || store->blocks.back().used + size > store->blocks.back().size) {
+			size_t bytes = std::max(block_size, size);
+			store->blocks.push_back({ std::unique_ptr<char[]>(new char[bytes]), bytes, 0 });
+		}
+		return store->blocks.back();
+	}
+
+private:
+	size_t block_size;
+	shared_ptr<storage> store;
+};
+
+#endif
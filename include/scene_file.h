@@ -0,0 +1,387 @@
+#pragma once
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <camera.h>
+#include <scene_arena.h>
+#include <mapped_file.h>
+#include <trace.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Scene description files.
+//
+// The text form has one statement per line; # starts a comment:
+//
+//     camera 0 0 0  0 0 -1  0 1 0  90      # from, at, up, vertical fov [, aspect]
+//     size 800 800                         # image settings, each optional
+//     spp 64
+//     max_depth 50
+//     seed 0
+//     sphere 0 0 -1 0.5                    # center, radius
+//     sphere 0 -100.5 -1 100
+//
+// Parsing a million spheres takes a good part of a second, so load() keeps
+// a binary copy next to the text file (path + ".cache"): a header followed
+// by the sphere records exactly as they sit in memory. When the cache was
+// made from the text as it is now (it records the text's size and
+// modification time) it is mapped instead of parsed, and the spheres are read
+// straight from the mapping. The cache is native-endian and only meant for
+// this machine.
+
+// Sphere as stored in the file and the cache, double precision either way.
+struct scene_sphere
+{
+	double center[3];
+	double radius;
+};
+
+struct scene_camera
+{
+	double from[3] = { 0, 0, 0 };
+	double at[3] = { 0, 0, -1 };
+	double up[3] = { 0, 1, 0 };
+	double vfov = 90;
+	double aspect = 0;          // 0: the image's width / height
+};
+
+// Render settings of the file; -1 where it gives none.
+struct scene_settings
+{
+	int32_t width = -1;
+	int32_t height = -1;
+	int32_t samples_per_pixel = -1;
+	int32_t max_depth = -1;
+	int32_t seed = -1;
+};
+
+class scene_file
+{
+public:
+	scene_file() {}
+
+	scene_file(const scene_file&) = delete;
+	scene_file& operator=(const scene_file&) = delete;
+
+	// Reads path through its cache, parsing (and rewriting the cache) only
+	// when the cache is missing or stale. On failure error says why.
+	bool load(const std::string& path, std::string& error) {
+		RT_TRACE_ZONE("load scene file");
+		uint64_t size;
+		int64_t modified;
+		if (!file_stamp(path, size, modified)) {
+			error = "cannot open " + path;
+			return false;
+		}
+		std::string cache_path = path + ".cache";
+		if (map_cache(cache_path, size, modified))
+			return true;
+		if (!read_text(path, error))
+			return false;
+		write_cache(cache_path, size, modified);
+		return true;
+	}
+
+	bool read_text(const std::string& path, std::string& error) {
+		clear();
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == nullptr) {
+			error = "cannot open " + path;
+			return false;
+		}
+		std::string text;
+		char buffer[1 << 16];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+			text.append(buffer, n);
+		}
+		fclose(file);
+
+		// lines are cut in place, no copy per line
+		int line_number = 0;
+		char* line = &text[0];
+		char* text_end = line + text.size();
+		while (line < text_end) {
+			line_number++;
+			char* end = static_cast<char*>(memchr(line, '\n', size_t(text_end - line)));
+			if (end == nullptr)
+				end = text_end;
+			*end = '\0';
+			if (!parse_line(line)) {
+				error = path + ":" + std::to_string(line_number) + ": cannot read '" + line + "'";
+				clear();
+				return false;
+			}
+			line = end + 1;
+		}
+		return true;
+	}
+
+	bool write_text(const std::string& path) const {
+		FILE* file = fopen(path.c_str(), "w");
+		if (file == nullptr)
+			return false;
+		const scene_camera& c = view;
+		fprintf(file, "camera %.17g %.17g %.17g  %.17g %.17g %.17g  %.17g %.17g %.17g  %.17g", c.from[0], c.from[1], c.from[2],
+			c.at[0], c.at[1], c.at[2], c.up[0], c.up[1], c.up[2], c.vfov);
+		if (c.aspect > 0)
+			fprintf(file, " %.17g", c.aspect);
+		fprintf(file, "\n");
+		if (settings.width > 0 && settings.height > 0)
+			fprintf(file, "size %d %d\n", settings.width, settings.height);
+		if (settings.samples_per_pixel > 0)
+			fprintf(file, "spp %d\n", settings.samples_per_pixel);
+		if (settings.max_depth >= 0)
+			fprintf(file, "max_depth %d\n", settings.max_depth);
+		if (settings.seed >= 0)
+			fprintf(file, "seed %d\n", settings.seed);
+		for (size_t k = 0; k < count; k++) {
+			const scene_sphere& s = records[k];
+			fprintf(file, "sphere %.17g %.17g %.17g %.17g\n", s.center[0], s.center[1], s.center[2], s.radius);
+		}
+		return fclose(file) == 0;
+	}
+
+	// Writes the binary form, stamped with the size and time of the text it mirrors.
+	bool write_cache(const std::string& path, uint64_t source_size, int64_t source_modified) const {
+		cache_header header;
+		memcpy(header.magic, cache_magic(), sizeof(header.magic));
+		header.sphere_count = count;
+		header.source_size = source_size;
+		header.source_modified = source_modified;
+		header.view = view;
+		header.settings = settings;
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if (file == nullptr)
+			return false;
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+			&& (count == 0 || fwrite(records, sizeof(scene_sphere), count, file) == count);
+		ok = fclose(file) == 0 && ok;
+		if (!ok)
+			std::remove(path.c_str());
+		return ok;
+	}
+
+	// Maps a cache written by write_cache; false if it is missing, damaged
+	// or was made from a different version of the text.
+	bool map_cache(const std::string& path, uint64_t source_size, int64_t source_modified) {
+		clear();
+		if (!mapping.open(path))
+			return false;
+		cache_header header;
+		bool ok = mapping.size() >= sizeof(header);
+		if (ok) {
+			memcpy(&header, mapping.data(), sizeof(header));
+			ok = memcmp(header.magic, cache_magic(), sizeof(header.magic)) == 0
+				&& header.version == cache_version && header.header_size == sizeof(header)
+				&& header.source_size == source_size && header.source_modified == source_modified
+				&& header.sphere_count <= (mapping.size() - sizeof(header)) / sizeof(scene_sphere);
+		}
+		if (!ok) {
+			mapping.close();
+			return false;
+		}
+		view = header.view;
+		settings = header.settings;
+		records = reinterpret_cast<const scene_sphere*>(mapping.data() + sizeof(header));
+		count = static_cast<size_t>(header.sphere_count);
+		cached = true;
+		return true;
+	}
+
+	void clear() {
+		mapping.close();
+		owned.clear();
+		records = nullptr;
+		count = 0;
+		cached = false;
+		view = scene_camera();
+		settings = scene_settings();
+	}
+
+	// Takes over spheres read from somewhere else, replacing the current ones.
+	void set_spheres(std::vector<scene_sphere> spheres) {
+		mapping.close();
+		owned = std::move(spheres);
+		records = owned.data();
+		count = owned.size();
+		cached = false;
+	}
+
+	void add_sphere(double x, double y, double z, double radius) {
+		use_owned();
+		owned.push_back({ { x, y, z }, radius });
+		records = owned.data();
+		count = owned.size();
+	}
+
+	// Copies the spheres of a list (nested lists included); other objects
+	// have no file form and are skipped. Returns how many were skipped.
+	int add(const hittable_list& list) {
+		int skipped = 0;
+		for (const auto& object : list.objects) {
+			if (const sphere* s = dynamic_cast<const sphere*>(object.get()))
+				add_sphere(s->center.x(), s->center.y(), s->center.z(), s->radius);
+			else if (const hittable_list* nested = dynamic_cast<const hittable_list*>(object.get()))
+				skipped += add(*nested);
+			else
+				skipped++;
+		}
+		return skipped;
+	}
+
+	const scene_sphere* spheres() const { return records; }
+	size_t sphere_count() const { return count; }
+
+	// Whether the last load() came from the mapped cache.
+	bool from_cache() const { return cached; }
+
+	hittable_list make_world(scene_arena* arena = nullptr) const {
+		RT_TRACE_ZONE("make world");
+		hittable_list world;
+		world.objects.reserve(count);
+		for (size_t k = 0; k < count; k++) {
+			const scene_sphere& s = records[k];
+			point3 center(real(s.center[0]), real(s.center[1]), real(s.center[2]));
+			world.add(arena != nullptr ? arena->make<sphere>(center, real(s.radius)) : make_shared<sphere>(center, real(s.radius)));
+		}
+		return world;
+	}
+
+	camera make_camera(int width, int height) const {
+		double aspect = view.aspect > 0 ? view.aspect : double(width) / height;
+		return camera(to_point(view.from), to_point(view.at), to_point(view.up), real(view.vfov), real(aspect));
+	}
+
+public:
+	scene_camera view;
+	scene_settings settings;
+
+private:
+	struct cache_header
+	{
+		char magic[8];
+		uint32_t version = cache_version;
+		uint32_t header_size = sizeof(cache_header);
+		uint64_t sphere_count = 0;
+		uint64_t source_size = 0;
+		int64_t source_modified = 0;
+		scene_camera view;
+		scene_settings settings;
+	};
+
+	static const uint32_t cache_version = 2;   // 2: source_modified in nanoseconds
+
+	// 8 bytes with the '\0'
+	static const char* cache_magic() {
+		return "RTSCENE";
+	}
+
+	static point3 to_point(const double* v) {
+		return point3(real(v[0]), real(v[1]), real(v[2]));
+	}
+
+	// A mapped cache is read-only; copy it before adding to it.
+	void use_owned() {
+		if (records != nullptr && records != owned.data()) {
+			owned.assign(records, records + count);
+			mapping.close();
+		}
+	}
+
+	static bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Reads the numbers that make up the rest of the line, up to max;
+	// returns how many, or -1 if anything else follows them.
+	static int read_numbers(const char* p, double* values, int max) {
+		int n = 0;
+		while (true) {
+			while (is_space(*p))
+				p++;
+			if (*p == '\0')
+				return n;
+			char* end;
+			double value = strtod(p, &end);
+			if (end == p || n == max)
+				return -1;
+			values[n++] = value;
+			p = end;
+		}
+	}
+
+	// One line, its '\n' already cut off. Blank lines and comments are fine.
+	bool parse_line(char* line) {
+		char* comment = strchr(line, '#');
+		if (comment != nullptr)
+			*comment = '\0';
+		while (is_space(*line))
+			line++;
+		if (*line == '\0')
+			return true;
+
+		const char* keyword = line;
+		while (*line != '\0' && !is_space(*line))
+			line++;
+		size_t keyword_length = size_t(line - keyword);
+		auto is = [&](const char* name) {
+			return strlen(name) == keyword_length && strncmp(keyword, name, keyword_length) == 0;
+		};
+		double v[11];
+		int n = read_numbers(line, v, 11);
+
+		if (is("sphere") && n == 4 && v[3] > 0) {
+			add_sphere(v[0], v[1], v[2], v[3]);
+			return true;
+		}
+		if (is("camera") && (n == 10 || n == 11)) {
+			scene_camera c;
+			for (int k = 0; k < 3; k++) {
+				c.from[k] = v[k];
+				c.at[k] = v[3 + k];
+				c.up[k] = v[6 + k];
+			}
+			c.vfov = v[9];
+			c.aspect = n == 11 ? v[10] : 0;
+			view = c;
+			return c.vfov > 0 && c.vfov < 180;
+		}
+		if (is("size") && n == 2 && v[0] >= 2 && v[1] >= 2) {
+			settings.width = int32_t(v[0]);
+			settings.height = int32_t(v[1]);
+			return true;
+		}
+		if (is("spp") && n == 1 && v[0] >= 1) {
+			settings.samples_per_pixel = int32_t(v[0]);
+			return true;
+		}
+		if (is("max_depth") && n == 1 && v[0] >= 0) {
+			settings.max_depth = int32_t(v[0]);
+			return true;
+		}
+		if (is("seed") && n == 1 && v[0] >= 0) {
+			settings.seed = int32_t(v[0]);
+			return true;
+		}
+		return false;
+	}
+
+private:
+	std::vector<scene_sphere> owned;
+	mapped_file mapping;
+	const scene_sphere* records = nullptr;   // owned.data() or inside mapping
+	size_t count = 0;
+	bool cached = false;
+};
+
+#endif
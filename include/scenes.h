@@ -0,0 +1,60 @@
+#pragma once
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <rtweekend.h>
+#include <hittable.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <path_tracer.h>
+#include <render_stats.h>
+#include <scene_arena.h>
+#include <trace.h>
+
+#include <algorithm>
+
+// Scenes shared by the viewer, the command-line renderer and the benchmarks.
+
+// A small sphere resting on a huge one, as seen by the default camera.
+inline hittable_list two_sphere_scene() {
+	hittable_list world;
+	world.add(make_shared<sphere>(point3(0, 0, -1), 0.5));
+	world.add(make_shared<sphere>(point3(0, -100.5, -1), 100));
+	return world;
+}
+
+// The ground sphere plus count small spheres scattered over it in front of
+// the default camera; the same seed always gives the same scene. With an
+// arena the spheres are allocated from it instead of one by one.
+inline hittable_list random_sphere_scene(int count, uint64_t seed = 1, scene_arena* arena = nullptr) {
+	RT_TRACE_ZONE("build scene");
+	auto make_sphere = [arena](point3 center, real radius) {
+		return arena != nullptr ? arena->make<sphere>(center, radius) : make_shared<sphere>(center, radius);
+	};
+
+	pcg32 rng(seed, 0);
+	hittable_list world;
+	world.objects.reserve(size_t(count) + 1);
+	world.add(make_sphere(point3(0, -100.5, -1), 100));
+	// keep the density roughly constant as the count grows
+	double spread = 2.0 * std::max(1.0, std::sqrt(count / 100.0));
+	double radius = 0.1 / std::max(1.0, std::cbrt(count / 100.0));
+	for (int n = 0; n < count; n++) {
+		double x = spread * (2 * rng.next_double() - 1);
+		double z = -1.0 - spread * rng.next_double();
+		double r = radius * (0.5 + rng.next_double());
+		world.add(make_sphere(point3(real(x), real(-0.5 + r), real(z)), real(r)));
+	}
+	return world;
+}
+
+// Surface normal mapped to a color, the background where nothing is hit.
+inline color normal_color(const ray& r, const hittable& world) {
+	RT_COUNT(rays);
+	hit_record rec;
+	if (world.hit(r, 0, infinity, rec))
+		return 0.5 * (rec.normal + color(1, 1, 1));
+	return background(r);
+}
+
+#endif
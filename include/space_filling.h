@@ -0,0 +1,155 @@
+#pragma once
+#ifndef SPACE_FILLING_H
+#define SPACE_FILLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Orders for walking a 2D grid. Row-major visits rows left to right; the
+// space-filling curves visit a square of side 2^k block by block, so pixels
+// (or tiles) visited close together in time are also close together in the
+// image: their rays hit the same part of the scene and their framebuffer
+// writes share cache lines. Morton (Z-order) is a bit interleave and cheap
+// to compute; Hilbert never jumps between non-adjacent cells but costs a
+// short loop per cell.
+enum class pixel_order { row_major, morton, hilbert };
+
+inline const char* pixel_order_name(pixel_order order) {
+	switch (order) {
+	case pixel_order::morton:
+		return "morton";
+	case pixel_order::hilbert:
+		return "hilbert";
+	default:
+		return "row";
+	}
+}
+
+// Spreads the low 16 bits of v to the even bits.
+inline uint32_t morton_spread(uint32_t v) {
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+inline uint32_t morton_compact(uint32_t v) {
+	v &= 0x55555555;
+	v = (v | (v >> 1)) & 0x33333333;
+	v = (v | (v >> 2)) & 0x0f0f0f0f;
+	v = (v | (v >> 4)) & 0x00ff00ff;
+	v = (v | (v >> 8)) & 0x0000ffff;
+	return v;
+}
+
+inline uint32_t morton_encode(uint32_t x, uint32_t y) {
+	return morton_spread(x) | (morton_spread(y) << 1);
+}
+
+inline void morton_decode(uint32_t code, uint32_t& x, uint32_t& y) {
+	x = morton_compact(code);
+	y = morton_compact(code >> 1);
+}
+
+// Spreads the low 10 bits of v to every third bit, for 3D Morton codes.
+inline uint32_t morton_spread3(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Interleaves the low 10 bits of x, y and z into 30 bits.
+inline uint32_t morton_encode3(uint32_t x, uint32_t y, uint32_t z) {
+	return morton_spread3(x) | (morton_spread3(y) << 1) | (morton_spread3(z) << 2);
+}
+
+// Position of (x, y) along the Hilbert curve over a side x side square,
+// side a power of two.
+inline uint32_t hilbert_encode(uint32_t side, uint32_t x, uint32_t y) {
+	uint32_t d = 0;
+	for (uint32_t s = side / 2; s > 0; s /= 2) {
+		uint32_t rx = (x & s) > 0 ? 1 : 0;
+		uint32_t ry = (y & s) > 0 ? 1 : 0;
+		d += s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant so the sub-curve starts where the last one ended
+		if (ry == 0) {
+			if (rx == 1) {
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			uint32_t t = x;
+			x = y;
+			y = t;
+		}
+	}
+	return d;
+}
+
+inline void hilbert_decode(uint32_t side, uint32_t d, uint32_t& x, uint32_t& y) {
+	x = y = 0;
+	for (uint32_t s = 1; s < side; s *= 2) {
+		uint32_t rx = 1 & (d / 2);
+		uint32_t ry = 1 & (d ^ rx);
+		if (ry == 0) {
+			if (rx == 1) {
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			uint32_t t = x;
+			x = y;
+			y = t;
+		}
+		x += s * rx;
+		y += s * ry;
+		d /= 4;
+	}
+}
+
+inline uint32_t next_power_of_two(uint32_t v) {
+	uint32_t p = 1;
+	while (p < v) {
+		p *= 2;
+	}
+	return p;
+}
+
+// Position of cell (x, y) in the order, on a grid padded to side x side
+// (a power of two) for the curves.
+inline uint32_t curve_index(pixel_order order, uint32_t side, uint32_t x, uint32_t y) {
+	switch (order) {
+	case pixel_order::morton:
+		return morton_encode(x, y);
+	case pixel_order::hilbert:
+		return hilbert_encode(side, x, y);
+	default:
+		return y * side + x;
+	}
+}
+
+// The cells of a side x side square (side a power of two) in visiting order.
+struct curve_cell
+{
+	uint16_t x, y;
+};
+
+inline std::vector<curve_cell> curve_cells(pixel_order order, uint32_t side) {
+	std::vector<curve_cell> cells(size_t(side) * side);
+	for (uint32_t d = 0; d < side * side; d++) {
+		uint32_t x = d % side;
+		uint32_t y = d / side;
+		if (order == pixel_order::morton)
+			morton_decode(d, x, y);
+		else if (order == pixel_order::hilbert)
+			hilbert_decode(side, d, x, y);
+		cells[d] = { uint16_t(x), uint16_t(y) };
+	}
+	return cells;
+}
+
+#endif
@@ -2,21 +2,42 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 #include<hittable.h>
+#include<render_stats.h>
+
+// Sphere parameters by value, for containers that store spheres contiguously
+// and intersect them without going through hittable.
+struct sphere_data
+{
+	point3 center;
+	real radius;
+};
 
 class sphere : public hittable
 {
 public:
-	sphere(point3 cen, double r) :center(cen), radius(r) {};
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	sphere(point3 cen, real r) :center(cen), radius(r) {};
+	virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
+
+	// The intersection behind hit(), callable without a sphere object.
+	static bool intersect(const point3& center, real radius, const ray& r, real t_min, real t_max, hit_record& rec);
+	static bool intersect(const sphere_data& s, const ray& r, real t_min, real t_max, hit_record& rec) {
+		return intersect(s.center, s.radius, r, t_min, t_max, rec);
+	}
 
 
 public:
 	point3 center;
-	double radius;
+	real radius;
 };
 
 
-bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+inline bool sphere::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+	return intersect(center, radius, r, t_min, t_max, rec);
+}
+
+inline bool sphere::intersect(const point3& center, real radius, const ray& r, real t_min, real t_max, hit_record& rec) {
+	RT_COUNT(sphere_tests);
 	vec3 oc = r.origin() - center;
 	auto a = r.direction().length_squared(); // equal to dot(dir, dir)
 	auto half_b = dot(oc, r.direction());
@@ -45,4 +66,10 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
 	
 	return true;
 }
+
+inline bool sphere::bounding_box(aabb& output_box) const {
+	vec3 extent(radius, radius, radius);
+	output_box = aabb(center - extent, center + extent);
+	return true;
+}
 #endif SPHERE_H
\ No newline at end of file
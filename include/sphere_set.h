@@ -0,0 +1,339 @@
+#pragma once
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include <hittable.h>
+#include <hittable_list.h>
+#include <sphere.h>
+#include <cpu_features.h>
+
+#include <vector>
+
+// Packed sphere container.
+// Centers and radii are stored structure-of-arrays, padded to a multiple of
+// the widest kernel, and one ray is intersected against 2 (SSE2) or 4 (AVX2)
+// spheres per instruction, twice that in an RT_USE_FLOAT build; the kernel
+// is picked at runtime from cpu_simd_level(). It is a plain hittable, so it
+// can stand in for a hittable_list of spheres or serve as a bvh leaf. Only
+// the nearest sphere gets a full hit_record.
+class sphere_set : public hittable
+{
+public:
+	sphere_set() {}
+
+	void add(const point3& center, real radius) {
+		// overwrite the first padding lane, or grow by one padded block
+		if (count == static_cast<int>(cx.size())) {
+			for (int k = 0; k < lanes; k++) {
+				cx.push_back(0);
+				cy.push_back(0);
+				cz.push_back(0);
+				radius2.push_back(-infinity);  // padding: the discriminant is never >= 0
+				radii.push_back(1);
+			}
+		}
+		cx[count] = center.x();
+		cy[count] = center.y();
+		cz[count] = center.z();
+		radius2[count] = radius * radius;
+		radii[count] = radius;
+		count++;
+	}
+
+	int size() const {
+		return count;
+	}
+
+	// Copies every sphere of the list; returns false (and copies nothing)
+	// if the list holds anything else.
+	static bool from_list(const std::vector<shared_ptr<hittable>>& objects, sphere_set& out) {
+		for (const auto& object : objects) {
+			if (dynamic_cast<const sphere*>(object.get()) == nullptr)
+				return false;
+		}
+		for (const auto& object : objects) {
+			const sphere* s = static_cast<const sphere*>(object.get());
+			out.add(s->center, s->radius);
+		}
+		return true;
+	}
+
+	virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override {
+		// a handful of spheres (e.g. a small compiled_scene) is faster without
+		// the vector setup and lane reduction
+		return hit(count < min_simd_count ? simd_level::scalar : cpu_simd_level(), r, t_min, t_max, rec);
+	}
+
+	// Forces a kernel; used by the benchmarks to compare them.
+	bool hit(simd_level level, const ray& r, real t_min, real t_max, hit_record& rec) const {
+		RT_COUNT_N(sphere_tests, count);
+		int index = -1;
+		real t = t_max;
+		switch (level) {
+#if RT_X86
+		case simd_level::avx2:
+			nearest_avx2(r, t_min, index, t);
+			break;
+		case simd_level::sse2:
+			nearest_sse2(r, t_min, index, t);
+			break;
+#endif
+		default:
+			nearest_scalar(r, t_min, index, t);
+			break;
+		}
+		if (index < 0)
+			return false;
+
+		point3 center(cx[index], cy[index], cz[index]);
+		rec.t = t;
+		rec.p = r.at(t);
+		vec3 outward_normal = (rec.p - center) / radii[index];
+		rec.set_face_normal(r, outward_normal);
+		return true;
+	}
+
+	virtual bool bounding_box(aabb& output_box) const override {
+		if (count == 0)
+			return false;
+		output_box = aabb();
+		for (int i = 0; i < count; i++) {
+			vec3 extent(radii[i], radii[i], radii[i]);
+			point3 center(cx[i], cy[i], cz[i]);
+			output_box.expand(center - extent, center + extent);
+		}
+		return true;
+	}
+
+private:
+	// All kernels follow sphere::hit: the near root if it lies in
+	// [t_min, t], else the far root. On return t is the nearest accepted root
+	// and index its sphere (unchanged when nothing was hit).
+	void nearest_scalar(const ray& r, real t_min, int& index, real& t) const {
+		vec3 d = r.direction();
+		auto a = d.length_squared();
+		for (int i = 0; i < count; i++) {
+			vec3 oc = r.origin() - point3(cx[i], cy[i], cz[i]);
+			auto half_b = dot(oc, d);
+			auto c = oc.length_squared() - radius2[i];
+			auto discriminant = half_b * half_b - a * c;
+			if (discriminant < 0)
+				continue;
+			auto sqrtd = sqrt(discriminant);
+			auto root = (-half_b - sqrtd) / a;
+			if (root < t_min || t < root) {
+				root = (-half_b + sqrtd) / a;
+				if (root < t_min || t < root)
+					continue;
+			}
+			t = root;
+			index = i;
+		}
+	}
+
+#if RT_X86 && !defined(RT_USE_FLOAT)
+	RT_TARGET_SSE2 void nearest_sse2(const ray& r, real t_min, int& index, real& t) const {
+		const __m128d ox = _mm_set1_pd(r.orig.x()), oy = _mm_set1_pd(r.orig.y()), oz = _mm_set1_pd(r.orig.z());
+		const __m128d dx = _mm_set1_pd(r.dir.x()), dy = _mm_set1_pd(r.dir.y()), dz = _mm_set1_pd(r.dir.z());
+		const __m128d a = _mm_set1_pd(r.dir.length_squared());
+		const __m128d lo = _mm_set1_pd(t_min);
+		const __m128d zero = _mm_setzero_pd();
+		__m128d best_t = _mm_set1_pd(t);
+		__m128d best_i = _mm_set1_pd(-1);
+		__m128d ids = _mm_set_pd(1, 0);
+		const __m128d step = _mm_set1_pd(2);
+
+		for (int i = 0; i < count; i += 2) {
+			__m128d ocx = _mm_sub_pd(ox, _mm_loadu_pd(&cx[i]));
+			__m128d ocy = _mm_sub_pd(oy, _mm_loadu_pd(&cy[i]));
+			__m128d ocz = _mm_sub_pd(oz, _mm_loadu_pd(&cz[i]));
+			__m128d half_b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, dx), _mm_mul_pd(ocy, dy)), _mm_mul_pd(ocz, dz));
+			__m128d oc2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)), _mm_mul_pd(ocz, ocz));
+			__m128d c = _mm_sub_pd(oc2, _mm_loadu_pd(&radius2[i]));
+			__m128d disc = _mm_sub_pd(_mm_mul_pd(half_b, half_b), _mm_mul_pd(a, c));
+			__m128d valid = _mm_cmpge_pd(disc, zero);
+			if (_mm_movemask_pd(valid) == 0) {
+				// most rays miss most spheres: skip the sqrt and divisions
+				ids = _mm_add_pd(ids, step);
+				continue;
+			}
+			__m128d sqrtd = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+			__m128d neg_b = _mm_sub_pd(zero, half_b);
+			__m128d near_root = _mm_div_pd(_mm_sub_pd(neg_b, sqrtd), a);
+			__m128d far_root = _mm_div_pd(_mm_add_pd(neg_b, sqrtd), a);
+			__m128d near_ok = _mm_and_pd(valid, _mm_and_pd(_mm_cmpge_pd(near_root, lo), _mm_cmple_pd(near_root, best_t)));
+			__m128d far_ok = _mm_and_pd(valid, _mm_and_pd(_mm_cmpge_pd(far_root, lo), _mm_cmple_pd(far_root, best_t)));
+			__m128d root = _mm_or_pd(_mm_and_pd(near_ok, near_root), _mm_andnot_pd(near_ok, far_root));
+			__m128d ok = _mm_or_pd(near_ok, far_ok);
+			best_t = _mm_or_pd(_mm_and_pd(ok, root), _mm_andnot_pd(ok, best_t));
+			best_i = _mm_or_pd(_mm_and_pd(ok, ids), _mm_andnot_pd(ok, best_i));
+			ids = _mm_add_pd(ids, step);
+		}
+
+		alignas(16) double lane_t[2], lane_i[2];
+		_mm_store_pd(lane_t, best_t);
+		_mm_store_pd(lane_i, best_i);
+		reduce_lanes(lane_t, lane_i, 2, index, t);
+	}
+
+	RT_TARGET_AVX2 void nearest_avx2(const ray& r, real t_min, int& index, real& t) const {
+		const __m256d ox = _mm256_set1_pd(r.orig.x()), oy = _mm256_set1_pd(r.orig.y()), oz = _mm256_set1_pd(r.orig.z());
+		const __m256d dx = _mm256_set1_pd(r.dir.x()), dy = _mm256_set1_pd(r.dir.y()), dz = _mm256_set1_pd(r.dir.z());
+		const __m256d a = _mm256_set1_pd(r.dir.length_squared());
+		const __m256d lo = _mm256_set1_pd(t_min);
+		const __m256d zero = _mm256_setzero_pd();
+		__m256d best_t = _mm256_set1_pd(t);
+		__m256d best_i = _mm256_set1_pd(-1);
+		__m256d ids = _mm256_set_pd(3, 2, 1, 0);
+		const __m256d step = _mm256_set1_pd(4);
+
+		for (int i = 0; i < count; i += 4) {
+			__m256d ocx = _mm256_sub_pd(ox, _mm256_loadu_pd(&cx[i]));
+			__m256d ocy = _mm256_sub_pd(oy, _mm256_loadu_pd(&cy[i]));
+			__m256d ocz = _mm256_sub_pd(oz, _mm256_loadu_pd(&cz[i]));
+			__m256d half_b = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, dx), _mm256_mul_pd(ocy, dy)), _mm256_mul_pd(ocz, dz));
+			__m256d oc2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz));
+			__m256d c = _mm256_sub_pd(oc2, _mm256_loadu_pd(&radius2[i]));
+			__m256d disc = _mm256_sub_pd(_mm256_mul_pd(half_b, half_b), _mm256_mul_pd(a, c));
+			__m256d valid = _mm256_cmp_pd(disc, zero, _CMP_GE_OQ);
+			if (_mm256_movemask_pd(valid) == 0) {
+				ids = _mm256_add_pd(ids, step);
+				continue;
+			}
+			__m256d sqrtd = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+			__m256d neg_b = _mm256_sub_pd(zero, half_b);
+			__m256d near_root = _mm256_div_pd(_mm256_sub_pd(neg_b, sqrtd), a);
+			__m256d far_root = _mm256_div_pd(_mm256_add_pd(neg_b, sqrtd), a);
+			__m256d near_ok = _mm256_and_pd(valid, _mm256_and_pd(_mm256_cmp_pd(near_root, lo, _CMP_GE_OQ), _mm256_cmp_pd(near_root, best_t, _CMP_LE_OQ)));
+			__m256d far_ok = _mm256_and_pd(valid, _mm256_and_pd(_mm256_cmp_pd(far_root, lo, _CMP_GE_OQ), _mm256_cmp_pd(far_root, best_t, _CMP_LE_OQ)));
+			__m256d root = _mm256_blendv_pd(far_root, near_root, near_ok);
+			__m256d ok = _mm256_or_pd(near_ok, far_ok);
+			best_t = _mm256_blendv_pd(best_t, root, ok);
+			best_i = _mm256_blendv_pd(best_i, ids, ok);
+			ids = _mm256_add_pd(ids, step);
+		}
+
+		alignas(32) double lane_t[4], lane_i[4];
+		_mm256_store_pd(lane_t, best_t);
+		_mm256_store_pd(lane_i, best_i);
+		reduce_lanes(lane_t, lane_i, 4, index, t);
+	}
+#elif RT_X86
+	// Single precision: twice the spheres per instruction.
+	RT_TARGET_SSE2 void nearest_sse2(const ray& r, real t_min, int& index, real& t) const {
+		const __m128 ox = _mm_set1_ps(r.orig.x()), oy = _mm_set1_ps(r.orig.y()), oz = _mm_set1_ps(r.orig.z());
+		const __m128 dx = _mm_set1_ps(r.dir.x()), dy = _mm_set1_ps(r.dir.y()), dz = _mm_set1_ps(r.dir.z());
+		const __m128 a = _mm_set1_ps(r.dir.length_squared());
+		const __m128 lo = _mm_set1_ps(t_min);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 best_t = _mm_set1_ps(t);
+		__m128 best_i = _mm_set1_ps(-1);
+		__m128 ids = _mm_set_ps(3, 2, 1, 0);
+		const __m128 step = _mm_set1_ps(4);
+
+		for (int i = 0; i < count; i += 4) {
+			__m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(&cx[i]));
+			__m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(&cy[i]));
+			__m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(&cz[i]));
+			__m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+			__m128 oc2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz));
+			__m128 c = _mm_sub_ps(oc2, _mm_loadu_ps(&radius2[i]));
+			__m128 disc = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+			__m128 valid = _mm_cmpge_ps(disc, zero);
+			if (_mm_movemask_ps(valid) == 0) {
+				ids = _mm_add_ps(ids, step);
+				continue;
+			}
+			__m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+			__m128 neg_b = _mm_sub_ps(zero, half_b);
+			__m128 near_root = _mm_div_ps(_mm_sub_ps(neg_b, sqrtd), a);
+			__m128 far_root = _mm_div_ps(_mm_add_ps(neg_b, sqrtd), a);
+			__m128 near_ok = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(near_root, lo), _mm_cmple_ps(near_root, best_t)));
+			__m128 far_ok = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(far_root, lo), _mm_cmple_ps(far_root, best_t)));
+			__m128 root = _mm_or_ps(_mm_and_ps(near_ok, near_root), _mm_andnot_ps(near_ok, far_root));
+			__m128 ok = _mm_or_ps(near_ok, far_ok);
+			best_t = _mm_or_ps(_mm_and_ps(ok, root), _mm_andnot_ps(ok, best_t));
+			best_i = _mm_or_ps(_mm_and_ps(ok, ids), _mm_andnot_ps(ok, best_i));
+			ids = _mm_add_ps(ids, step);
+		}
+
+		alignas(16) float lane_t[4], lane_i[4];
+		_mm_store_ps(lane_t, best_t);
+		_mm_store_ps(lane_i, best_i);
+		reduce_lanes(lane_t, lane_i, 4, index, t);
+	}
+
+	RT_TARGET_AVX2 void nearest_avx2(const ray& r, real t_min, int& index, real& t) const {
+		const __m256 ox = _mm256_set1_ps(r.orig.x()), oy = _mm256_set1_ps(r.orig.y()), oz = _mm256_set1_ps(r.orig.z());
+		const __m256 dx = _mm256_set1_ps(r.dir.x()), dy = _mm256_set1_ps(r.dir.y()), dz = _mm256_set1_ps(r.dir.z());
+		const __m256 a = _mm256_set1_ps(r.dir.length_squared());
+		const __m256 lo = _mm256_set1_ps(t_min);
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 best_t = _mm256_set1_ps(t);
+		__m256 best_i = _mm256_set1_ps(-1);
+		__m256 ids = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+		const __m256 step = _mm256_set1_ps(8);
+
+		for (int i = 0; i < count; i += 8) {
+			__m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&cx[i]));
+			__m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&cy[i]));
+			__m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&cz[i]));
+			__m256 half_b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+			__m256 oc2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+			__m256 c = _mm256_sub_ps(oc2, _mm256_loadu_ps(&radius2[i]));
+			__m256 disc = _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(a, c));
+			__m256 valid = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+			if (_mm256_movemask_ps(valid) == 0) {
+				ids = _mm256_add_ps(ids, step);
+				continue;
+			}
+			__m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+			__m256 neg_b = _mm256_sub_ps(zero, half_b);
+			__m256 near_root = _mm256_div_ps(_mm256_sub_ps(neg_b, sqrtd), a);
+			__m256 far_root = _mm256_div_ps(_mm256_add_ps(neg_b, sqrtd), a);
+			__m256 near_ok = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(near_root, lo, _CMP_GE_OQ), _mm256_cmp_ps(near_root, best_t, _CMP_LE_OQ)));
+			__m256 far_ok = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(far_root, lo, _CMP_GE_OQ), _mm256_cmp_ps(far_root, best_t, _CMP_LE_OQ)));
+			__m256 root = _mm256_blendv_ps(far_root, near_root, near_ok);
+			__m256 ok = _mm256_or_ps(near_ok, far_ok);
+			best_t = _mm256_blendv_ps(best_t, root, ok);
+			best_i = _mm256_blendv_ps(best_i, ids, ok);
+			ids = _mm256_add_ps(ids, step);
+		}
+
+		alignas(32) float lane_t[8], lane_i[8];
+		_mm256_store_ps(lane_t, best_t);
+		_mm256_store_ps(lane_i, best_i);
+		reduce_lanes(lane_t, lane_i, 8, index, t);
+	}
+#endif
+
+	// Lanes carry sphere indices as floating point, exact up to 2^24 in float.
+	// Nearest lane wins; on a tie the higher sphere index, as a linear list would.
+	static void reduce_lanes(const real* lane_t, const real* lane_i, int n, int& index, real& t) {
+		for (int k = 0; k < n; k++) {
+			int i = static_cast<int>(lane_i[k]);
+			if (i < 0)
+				continue;
+			if (index < 0 || lane_t[k] < t || (lane_t[k] == t && i > index)) {
+				t = lane_t[k];
+				index = i;
+			}
+		}
+	}
+
+private:
+	static const int min_simd_count = 4;
+
+#ifdef RT_USE_FLOAT
+	static const int lanes = 8;  // padding granularity, the widest kernel
+#else
+	static const int lanes = 4;
+#endif
+
+	int count = 0;
+	std::vector<real> cx, cy, cz;
+	std::vector<real> radius2;
+	std::vector<real> radii;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include <glad/glad.h>
+#include <dirty_tiles.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Keeps a GL texture in sync with an RGBA8 framebuffer the renderer writes.
+// The texture storage is only (re)allocated when the size changes; after
+// that each upload() sends just the tiles marked dirty since the last one,
+// with glTexSubImage2D reading straight from the framebuffer rows. With
+// use_pbo the changed tiles are first packed into one of two pixel buffer
+// objects (orphaned each time), so the driver can copy them to the texture
+// asynchronously instead of before glTexSubImage2D returns.
+// Needs the GL context current on the calling thread; viewer only.
+class texture_stream
+{
+public:
+	texture_stream() {}
+
+	texture_stream(const texture_stream&) = delete;
+	texture_stream& operator=(const texture_stream&) = delete;
+
+	// Uploads the dirty tiles of rgba (width x height, row 0 first) into texture.
+	void upload(GLuint texture, const uint8_t* rgba, int width, int height, dirty_tiles& dirty) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		bool reallocated = allocate(texture, width, height);
+		std::vector<tile> changed = dirty.take();
+		if (reallocated || dirty.width() != width || dirty.height() != height)
+			changed.assign(1, tile{ 0, 0, width, height });
+		upload_tiles(rgba, width, changed);
+	}
+
+	// Uploads all of rgba, for views that change completely every frame.
+	void upload_all(GLuint texture, const uint8_t* rgba, int width, int height) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		allocate(texture, width, height);
+		upload_tiles(rgba, width, std::vector<tile>(1, tile{ 0, 0, width, height }));
+	}
+
+	// Deletes the pixel buffers; call while the context is still alive.
+	void release() {
+		if (pbos[0] != 0)
+			glDeleteBuffers(2, pbos);
+		pbos[0] = pbos[1] = 0;
+	}
+
+public:
+	bool use_pbo = false;
+	int last_tiles = 0;         // rectangles sent by the last upload
+	size_t last_bytes = 0;      // and their size
+
+private:
+	// Allocates the texture storage if texture or size changed; returns whether it did.
+	bool allocate(GLuint texture, int width, int height) {
+		if (texture == allocated_texture && width == allocated_width && height == allocated_height)
+			return false;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		allocated_texture = texture;
+		allocated_width = width;
+		allocated_height = height;
+		return true;
+	}
+
+	void upload_tiles(const uint8_t* rgba, int width, const std::vector<tile>& changed) {
+		last_tiles = static_cast<int>(changed.size());
+		last_bytes = 0;
+		for (const tile& t : changed) {
+			last_bytes += size_t(t.x1 - t.x0) * (t.y1 - t.y0) * 4;
+		}
+		if (changed.empty())
+			return;
+
+		if (use_pbo && upload_through_pbo(rgba, width, changed))
+			return;
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+		for (const tile& t : changed) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, t.x0, t.y0, t.x1 - t.x0, t.y1 - t.y0, GL_RGBA, GL_UNSIGNED_BYTE,
+				rgba + (size_t(t.y0) * width + t.x0) * 4);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+
+	// Packs the tiles back to back into the next pixel buffer and uploads
+	// from there. False (nothing uploaded) if the buffer cannot be mapped.
+	bool upload_through_pbo(const uint8_t* rgba, int width, const std::vector<tile>& changed) {
+		if (pbos[0] == 0)
+			glGenBuffers(2, pbos);
+		GLuint pbo = pbos[next_pbo];
+		next_pbo ^= 1;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, last_bytes, nullptr, GL_STREAM_DRAW);
+		uint8_t* mapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, last_bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+		if (mapped == nullptr) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return false;
+		}
+
+		size_t offset = 0;
+		std::vector<size_t> offsets;
+		for (const tile& t : changed) {
+			offsets.push_back(offset);
+			size_t row_bytes = size_t(t.x1 - t.x0) * 4;
+			for (int y = t.y0; y < t.y1; y++) {
+				memcpy(mapped + offset, rgba + (size_t(y) * width + t.x0) * 4, row_bytes);
+				offset += row_bytes;
+			}
+		}
+		bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+
+		// the tiles are tightly packed in the buffer, the pointer argument is an offset into it
+		if (intact) {
+			for (size_t k = 0; k < changed.size(); k++) {
+				const tile& t = changed[k];
+				glTexSubImage2D(GL_TEXTURE_2D, 0, t.x0, t.y0, t.x1 - t.x0, t.y1 - t.y0, GL_RGBA, GL_UNSIGNED_BYTE,
+					reinterpret_cast<const void*>(offsets[k]));
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return intact;
+	}
+
+private:
+	GLuint allocated_texture = 0;
+	int allocated_width = 0;
+	int allocated_height = 0;
+	GLuint pbos[2] = { 0, 0 };
+	int next_pbo = 0;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <trace.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pops its own tasks from the back (the most
+// recently queued, still warm in cache) and, once it runs dry, steals from the
+// front of the other workers' deques. The thread calling wait() helps out the
+// same way instead of sleeping.
+class thread_pool
+{
+public:
+	using task = std::function<void()>;
+
+	explicit thread_pool(int thread_count = 0) : queues(thread_count > 0 ? thread_count : default_thread_count()) {
+		for (int i = 0; i < size(); i++) {
+			workers.emplace_back([this, i] { worker_loop(i); });
+		}
+	}
+
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	static int default_thread_count() {
+		int n = static_cast<int>(std::thread::hardware_concurrency());
+		return n > 0 ? n : 1;
+	}
+
+	int size() const {
+		return static_cast<int>(queues.size());
+	}
+
+	// Tasks queued from inside a worker go to that worker's own deque,
+	// everything else is spread round-robin.
+	void submit(task t) {
+		int self = current_worker();
+		int target = self >= 0 ? self : next_queue++ % size();
+		pending++;
+		{
+			std::lock_guard<std::mutex> lock(queues[target].mutex);
+			queues[target].tasks.push_back(std::move(t));
+		}
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+			queued++;
+		}
+		wake.notify_one();
+	}
+
+	// Blocks until every submitted task has finished.
+	void wait() {
+		int origin = 0;
+		while (pending > 0) {
+			task t;
+			if (pop_task(origin++ % size(), t)) {
+				run_task(t);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(done_mutex);
+			done.wait(lock, [this] { return pending == 0 || queued > 0; });
+		}
+	}
+
+private:
+	struct worker_queue {
+		std::mutex mutex;
+		std::deque<task> tasks;
+	};
+
+	struct worker_identity {
+		const thread_pool* pool = nullptr;
+		int index = -1;
+	};
+
+	static worker_identity& identity() {
+		static thread_local worker_identity id;
+		return id;
+	}
+
+	int current_worker() const {
+		return identity().pool == this ? identity().index : -1;
+	}
+
+	// Own deque first (LIFO), then steal from the others (FIFO).
+	bool pop_task(int self, task& t) {
+		{
+			worker_queue& own = queues[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty()) {
+				t = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				queued--;
+				return true;
+			}
+		}
+		for (int k = 1; k < size(); k++) {
+			worker_queue& victim = queues[(self + k) % size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				t = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				queued--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run_task(task& t) {
+		t();
+		if (--pending == 0) {
+			std::lock_guard<std::mutex> lock(done_mutex);
+			done.notify_all();
+		}
+	}
+
+	void worker_loop(int self) {
+		identity().pool = this;
+		identity().index = self;
+		RT_TRACE_THREAD(("worker " + std::to_string(self)).c_str());
+		while (true) {
+			task t;
+			if (pop_task(self, t)) {
+				run_task(t);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake.wait(lock, [this] { return stopping || queued > 0; });
+			if (stopping && queued == 0)
+				return;
+		}
+	}
+
+private:
+	std::vector<worker_queue> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<int> queued{ 0 };   // tasks sitting in a deque
+	std::atomic<int> pending{ 0 };  // tasks submitted but not yet finished
+	std::atomic<unsigned> next_queue{ 0 };
+	bool stopping = false;
+
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::mutex done_mutex;
+	std::condition_variable done;
+};
+
+#endif
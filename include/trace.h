@@ -0,0 +1,259 @@
+#pragma once
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of where a render spends its time, exported as Chrome trace-event
+// JSON (open it in Perfetto, ui.perfetto.dev, or chrome://tracing).
+//
+//     RT_TRACE_ZONE("tile");      // records the enclosing scope
+//
+// Each thread appends its finished zones to a buffer of its own without
+// locking: the write of an event is published by a release store of the
+// buffer's count, and readers only look below that count. Buffers are
+// registered once per thread and handed on to a later thread when theirs
+// exits. While tracing is stopped a zone costs one relaxed load; defining
+// RT_NO_TRACE compiles the zones out. Zone names must be string literals
+// (only the pointer is stored).
+
+struct trace_event
+{
+	const char* name;
+	int64_t begin;      // steady_clock nanoseconds
+	int64_t end;
+};
+
+inline int64_t trace_now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The events of one thread. Only the owning thread records; start() and
+// export lock the mutex, and the owner takes it (without waiting) only to
+// empty the buffer when a new capture asked for that.
+class trace_buffer
+{
+public:
+	static const size_t capacity = 1 << 17;
+
+	explicit trace_buffer(int id) : thread_id(id), events(new trace_event[capacity]) {}
+
+	void record(const char* name, int64_t begin, int64_t end) {
+		if (reset_requested.load(std::memory_order_acquire)) {
+			std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+			if (!lock.owns_lock()) {
+				// being exported: it does not want this event anyway
+				dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return;
+			}
+			count.store(0, std::memory_order_relaxed);
+			dropped.store(0, std::memory_order_relaxed);
+			reset_requested.store(false, std::memory_order_relaxed);
+		}
+		size_t n = count.load(std::memory_order_relaxed);
+		if (n == capacity) {
+			dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+		events[n] = { name, begin, end };
+		count.store(n + 1, std::memory_order_release);
+	}
+
+public:
+	const int thread_id;
+	std::string name;           // guarded by trace_log's mutex
+	bool in_use = true;         // by a live thread; guarded by trace_log's mutex
+
+	std::mutex mutex;
+	std::unique_ptr<trace_event[]> events;
+	std::atomic<size_t> count{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<bool> reset_requested{ false };
+};
+
+// All threads' buffers, and whether zones are being recorded.
+class trace_log
+{
+public:
+	static trace_log& global() {
+		static trace_log log;
+		return log;
+	}
+
+	bool enabled() const {
+		return on.load(std::memory_order_relaxed);
+	}
+
+	// Begins a new capture: every buffer drops what it holds (its owner
+	// empties it at its next zone) and zones are recorded from now on.
+	void start() {
+		std::lock_guard<std::mutex> lock(mutex);
+		capture_start = trace_now();
+		for (auto& buffer : buffers) {
+			buffer->reset_requested.store(true, std::memory_order_release);
+		}
+		on.store(true, std::memory_order_relaxed);
+	}
+
+	// Stops recording; the capture stays until the next start().
+	void stop() {
+		on.store(false, std::memory_order_relaxed);
+	}
+
+	void record(const char* name, int64_t begin, int64_t end) {
+		trace_buffer* buffer = thread_buffer();
+		if (buffer != nullptr)
+			buffer->record(name, begin, end);
+	}
+
+	// Names the calling thread in the exported timeline.
+	void set_thread_name(const char* name) {
+		this_thread().name = name;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (this_thread().buffer != nullptr)
+			this_thread().buffer->name = name;
+	}
+
+	// Writes the zones of the current capture, which may still be running.
+	bool write_chrome_json(const std::string& path, size_t* written = nullptr, uint64_t* dropped = nullptr) {
+		FILE* file = fopen(path.c_str(), "w");
+		if (file == nullptr)
+			return false;
+		size_t events = 0;
+		uint64_t lost = 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"raytracer\"}}");
+		for (auto& buffer : buffers) {
+			std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", buffer->thread_id);
+			write_escaped(file, buffer->name.c_str());
+			fprintf(file, "\"}}");
+			if (buffer->reset_requested.load(std::memory_order_acquire))
+				continue;   // holds only events from before the capture
+			size_t n = buffer->count.load(std::memory_order_acquire);
+			for (size_t k = 0; k < n; k++) {
+				const trace_event& e = buffer->events[k];
+				if (e.begin < capture_start)
+					continue;   // entered before the capture started
+				events++;
+				fprintf(file, ",\n{\"name\":\"");
+				write_escaped(file, e.name);
+				fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", buffer->thread_id,
+					(e.begin - capture_start) * 1e-3, (e.end - e.begin) * 1e-3);
+			}
+			lost += buffer->dropped.load(std::memory_order_relaxed);
+		}
+		fprintf(file, "\n]}\n");
+		if (written != nullptr)
+			*written = events;
+		if (dropped != nullptr)
+			*dropped = lost;
+		return fclose(file) == 0;
+	}
+
+private:
+	trace_log() {}
+
+	// Hands the thread's buffer back when the thread exits.
+	struct thread_state
+	{
+		trace_buffer* buffer = nullptr;
+		std::string name;
+
+		~thread_state() {
+			if (buffer != nullptr)
+				trace_log::global().release(buffer);
+		}
+	};
+
+	static thread_state& this_thread() {
+		static thread_local thread_state state;
+		return state;
+	}
+
+	trace_buffer* thread_buffer() {
+		thread_state& state = this_thread();
+		if (state.buffer == nullptr)
+			state.buffer = acquire(state.name);
+		return state.buffer;
+	}
+
+	// A buffer left by an exited thread, or a new one.
+	trace_buffer* acquire(const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		trace_buffer* buffer = nullptr;
+		for (auto& b : buffers) {
+			if (!b->in_use) {
+				buffer = b.get();
+				break;
+			}
+		}
+		if (buffer == nullptr) {
+			buffers.emplace_back(new trace_buffer(static_cast<int>(buffers.size()) + 1));
+			buffer = buffers.back().get();
+		}
+		buffer->in_use = true;
+		buffer->name = name.empty() ? "thread " + std::to_string(buffer->thread_id) : name;
+		return buffer;
+	}
+
+	void release(trace_buffer* buffer) {
+		std::lock_guard<std::mutex> lock(mutex);
+		buffer->in_use = false;
+	}
+
+	static void write_escaped(FILE* file, const char* text) {
+		for (const char* c = text; *c != '\0'; c++) {
+			if (*c == '"' || *c == '\\')
+				fputc('\\', file);
+			if (static_cast<unsigned char>(*c) >= 0x20)
+				fputc(*c, file);
+		}
+	}
+
+private:
+	std::atomic<bool> on{ false };
+	std::mutex mutex;
+	std::vector<std::unique_ptr<trace_buffer>> buffers;
+	int64_t capture_start = 0;
+};
+
+// Records the scope it lives in, if tracing was on when it was entered.
+class trace_zone
+{
+public:
+	explicit trace_zone(const char* zone_name) : name(zone_name), begin(trace_log::global().enabled() ? trace_now() : -1) {}
+
+	~trace_zone() {
+		if (begin >= 0)
+			trace_log::global().record(name, begin, trace_now());
+	}
+
+	trace_zone(const trace_zone&) = delete;
+	trace_zone& operator=(const trace_zone&) = delete;
+
+private:
+	const char* name;
+	int64_t begin;
+};
+
+#define RT_TRACE_JOIN2(a, b) a##b
+#define RT_TRACE_JOIN(a, b) RT_TRACE_JOIN2(a, b)
+
+#ifdef RT_NO_TRACE
+#define RT_TRACE_ZONE(name) ((void)0)
+#define RT_TRACE_THREAD(name) ((void)0)
+#else
+#define RT_TRACE_ZONE(name) trace_zone RT_TRACE_JOIN(trace_zone_, __LINE__)(name)
+#define RT_TRACE_THREAD(name) trace_log::global().set_thread_name(name)
+#endif
+
+#endif
@@ -0,0 +1,351 @@
+#pragma once
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <rtweekend.h>
+#include <hittable.h>
+#include <path_tracer.h>
+#include <render_stats.h>
+#include <trace.h>
+#include <space_filling.h>
+#include <sampler.h>
+#include <sampling.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Wavefront (stream) path tracing: instead of following one path from the
+// camera to its end, a batch of paths advances one bounce at a time through
+// separate stages, each a loop over the whole batch:
+//
+//     generate    camera rays of the batch's pixels (the caller: add())
+//     extend      nearest hit of every queued ray
+//     shade       background for misses, roulette, next diffuse bounce;
+//                 survivors are compacted to the front of the queue
+//     accumulate  the caller reads radiance[] once the queue is empty
+//
+// The path state lives in a structure-of-arrays queue, so a stage streams
+// through just the fields it uses. Every path carries its own pcg32 and
+// sampler state, taken from the thread's when it is added, and the shade
+// stage swaps them in for the path's random numbers: a path draws exactly
+// the numbers path_tracer would draw for it, and the image is identical to
+// one traced path by path.
+//
+// Only the camera rays are intersected in batches (as packets). Extend
+// still makes one world.hit() per bounce ray, so the stage split costs
+// queue traffic and gains nothing: no faster than primary packets, and
+// slower than path_tracer on small scenes. Two batched extends lost to
+// per-ray traversal on the bench scenes, whose diffuse bounce rays are too
+// incoherent: a bvh stream traversal of the whole queue, and bvh packets
+// over the same-octant runs of the sorted queue (a run's direction bounds
+// are too wide to cull anything). Until a kernel pays for itself the
+// integrator stays out of the CLI and the viewer; the wavefront bench
+// tracks it.
+//
+// With reorder set, the queued bounce rays are sorted before each extend
+// by the Morton code of their origin and then by direction octant, so
+// consecutive traversals start in the same part of the scene, head the
+// same way and find its nodes still in cache. Paths keep their own random
+// numbers and radiance slot, so sorting does not change the image either.
+
+// Live paths, one entry per array index.
+struct path_queue
+{
+	std::vector<real> ox, oy, oz;       // ray origin
+	std::vector<real> dx, dy, dz;       // ray direction
+	std::vector<real> tr, tg, tb;       // throughput
+	std::vector<int32_t> path;          // index into wavefront_batch::radiance
+	std::vector<int32_t> segments;      // rays traced so far, this one included
+	std::vector<uint64_t> rng_state, rng_inc;
+	std::vector<pixel_sample> sample;   // sampler state, see sampler.h
+
+	// extend results
+	std::vector<uint8_t> hit;
+	std::vector<real> px, py, pz;       // hit point
+	std::vector<real> nx, ny, nz;       // normal against the ray
+
+	int size = 0;
+
+	void resize(int n) {
+		size_t s = size_t(n);
+		for (std::vector<real>* v : { &ox, &oy, &oz, &dx, &dy, &dz, &tr, &tg, &tb, &px, &py, &pz, &nx, &ny, &nz }) {
+			v->resize(s);
+		}
+		path.resize(s);
+		segments.resize(s);
+		rng_state.resize(s);
+		rng_inc.resize(s);
+		sample.resize(s);
+		hit.resize(s);
+	}
+
+	void set_ray(int k, const ray& r) {
+		ox[k] = r.origin().x();
+		oy[k] = r.origin().y();
+		oz[k] = r.origin().z();
+		dx[k] = r.direction().x();
+		dy[k] = r.direction().y();
+		dz[k] = r.direction().z();
+	}
+
+	ray get_ray(int k) const {
+		return ray(point3(ox[k], oy[k], oz[k]), vec3(dx[k], dy[k], dz[k]));
+	}
+
+	// Copies entry from of source to entry to, extend results excluded;
+	// source may be this queue if to <= from.
+	void copy(const path_queue& source, int from, int to) {
+		ox[to] = source.ox[from];
+		oy[to] = source.oy[from];
+		oz[to] = source.oz[from];
+		dx[to] = source.dx[from];
+		dy[to] = source.dy[from];
+		dz[to] = source.dz[from];
+		tr[to] = source.tr[from];
+		tg[to] = source.tg[from];
+		tb[to] = source.tb[from];
+		path[to] = source.path[from];
+		segments[to] = source.segments[from];
+		rng_state[to] = source.rng_state[from];
+		rng_inc[to] = source.rng_inc[from];
+		sample[to] = source.sample[from];
+	}
+
+	void swap(path_queue& other) {
+		ox.swap(other.ox);
+		oy.swap(other.oy);
+		oz.swap(other.oz);
+		dx.swap(other.dx);
+		dy.swap(other.dy);
+		dz.swap(other.dz);
+		tr.swap(other.tr);
+		tg.swap(other.tg);
+		tb.swap(other.tb);
+		px.swap(other.px);
+		py.swap(other.py);
+		pz.swap(other.pz);
+		nx.swap(other.nx);
+		ny.swap(other.ny);
+		nz.swap(other.nz);
+		path.swap(other.path);
+		segments.swap(other.segments);
+		rng_state.swap(other.rng_state);
+		rng_inc.swap(other.rng_inc);
+		sample.swap(other.sample);
+		hit.swap(other.hit);
+		std::swap(size, other.size);
+	}
+};
+
+// The paths of one batch (e.g. a tile): add() each camera ray, run
+// wavefront_tracer::trace(), then read radiance[] in the order of add().
+// Reused between batches, so the arrays are allocated once per thread.
+struct wavefront_batch
+{
+	path_queue queue;
+	std::vector<color> radiance;
+
+	// reorder scratch
+	path_queue sorted;
+	std::vector<uint64_t> keys;
+
+	void clear() {
+		queue.size = 0;
+		radiance.clear();
+	}
+
+	// Queues a path from camera ray r; its random numbers continue from the
+	// calling thread's generator and sampler as they are now. Returns the
+	// path's index.
+	int add(const ray& r) {
+		int k = queue.size;
+		if (k == int(queue.ox.size()))
+			queue.resize(std::max(256, 2 * k));
+		queue.set_ray(k, r);
+		queue.tr[k] = queue.tg[k] = queue.tb[k] = 1;
+		queue.path[k] = int32_t(radiance.size());
+		queue.segments[k] = 1;
+		queue.rng_state[k] = thread_rng().state;
+		queue.rng_inc[k] = thread_rng().inc;
+		queue.sample[k] = thread_sample();
+		queue.size++;
+		radiance.push_back(color(0, 0, 0));
+		return queue.path[k];
+	}
+};
+
+// path_tracer's integrator (diffuse bounces, sky background, russian
+// roulette after roulette_depth rays, at most max_depth rays) in stages.
+class wavefront_tracer
+{
+public:
+	wavefront_tracer(int max_depth, int roulette_depth = 3, path_stats* stats = nullptr)
+		: max_depth(max_depth), roulette_depth(roulette_depth), stats(stats) {}
+
+	// Runs every path of the batch to its end. The camera rays, which share
+	// one origin, are traced as ray packets, so a bvh culls whole subtrees
+	// for up to ray_packet::max_size of them at once.
+	void trace(wavefront_batch& batch, const hittable& world) const {
+		path_queue& q = batch.queue;
+		if (max_depth <= 0) {
+			q.size = 0;
+			return;
+		}
+		extend_packets(q, world);
+		shade(batch);
+		while (q.size > 0) {
+			if (reorder)
+				sort_rays(batch);
+			extend(q, world);
+			shade(batch);
+		}
+	}
+
+public:
+	bool reorder = false;       // sort bounce rays before extending them
+
+private:
+	void extend_packets(path_queue& q, const hittable& world) const {
+		RT_TRACE_ZONE("extend");
+		for (int first = 0; first < q.size; first += ray_packet::max_size) {
+			int n = std::min(int(ray_packet::max_size), q.size - first);
+			ray_packet packet;
+			for (int k = 0; k < n; k++) {
+				packet.add(q.get_ray(first + k));
+			}
+			world.hit_packet(packet, real(0.001));
+			for (int k = 0; k < n; k++) {
+				store_hit(q, first + k, packet.hit[k], packet.rec[k]);
+			}
+		}
+	}
+
+	void extend(path_queue& q, const hittable& world) const {
+		RT_TRACE_ZONE("extend");
+		for (int k = 0; k < q.size; k++) {
+			hit_record rec;
+			bool hit = world.hit(q.get_ray(k), real(0.001), infinity, rec);
+			store_hit(q, k, hit, rec);
+		}
+	}
+
+	static void store_hit(path_queue& q, int k, bool hit, const hit_record& rec) {
+		q.hit[k] = hit ? 1 : 0;
+		if (!hit)
+			return;
+		q.px[k] = rec.p.x();
+		q.py[k] = rec.p.y();
+		q.pz[k] = rec.p.z();
+		q.nx[k] = rec.normal.x();
+		q.ny[k] = rec.normal.y();
+		q.nz[k] = rec.normal.z();
+	}
+
+	// One bounce of every queued path, in path_tracer::trace_from_hit's
+	// order of operations (and random numbers).
+	void shade(wavefront_batch& batch) const {
+		RT_TRACE_ZONE("shade");
+		path_queue& q = batch.queue;
+		pcg32& rng = thread_rng();
+		pixel_sample& sample = thread_sample();
+		int live = 0;
+		for (int k = 0; k < q.size; k++) {
+			int segments = q.segments[k];
+			if (!q.hit[k]) {
+				color throughput(q.tr[k], q.tg[k], q.tb[k]);
+				batch.radiance[q.path[k]] = throughput * background(q.get_ray(k));
+				finish(segments);
+				continue;
+			}
+			if (segments >= max_depth) {
+				finish(segments);
+				continue;
+			}
+
+			rng.state = q.rng_state[k];
+			rng.inc = q.rng_inc[k];
+			sample = q.sample[k];
+			color throughput = real(0.5) * color(q.tr[k], q.tg[k], q.tb[k]);
+			if (segments >= roulette_depth) {
+				real survive = std::min(real(0.95), std::max(throughput.x(), std::max(throughput.y(), throughput.z())));
+				if (sample_1d() >= survive) {
+					finish(segments);
+					continue;
+				}
+				throughput = throughput / survive;
+			}
+
+			double u, v;
+			sample_2d(u, v);
+			vec3 direction = sample_cosine_direction(vec3(q.nx[k], q.ny[k], q.nz[k]), u, v);
+			if (k != live)
+				q.copy(q, k, live);
+			q.set_ray(live, ray(point3(q.px[k], q.py[k], q.pz[k]), direction));
+			q.tr[live] = throughput.x();
+			q.tg[live] = throughput.y();
+			q.tb[live] = throughput.z();
+			q.segments[live] = segments + 1;
+			q.rng_state[live] = rng.state;
+			q.sample[live] = sample;
+			live++;
+		}
+		q.size = live;
+	}
+
+	// Sorts the queue by a 30-bit key: the Morton code of the origin on a
+	// 512^3 grid over the origins' bounds, then the direction octant.
+	void sort_rays(wavefront_batch& batch) const {
+		RT_TRACE_ZONE("reorder");
+		path_queue& q = batch.queue;
+		if (q.size < 2)
+			return;
+		real lo[3] = { infinity, infinity, infinity };
+		real hi[3] = { -infinity, -infinity, -infinity };
+		const std::vector<real>* origin[3] = { &q.ox, &q.oy, &q.oz };
+		for (int a = 0; a < 3; a++) {
+			const real* o = origin[a]->data();
+			for (int k = 0; k < q.size; k++) {
+				lo[a] = std::min(lo[a], o[k]);
+				hi[a] = std::max(hi[a], o[k]);
+			}
+		}
+		real scale[3];
+		for (int a = 0; a < 3; a++) {
+			scale[a] = hi[a] > lo[a] ? real(511.99) / (hi[a] - lo[a]) : real(0);
+		}
+
+		batch.keys.resize(size_t(q.size));
+		for (int k = 0; k < q.size; k++) {
+			uint32_t cell = morton_encode3(uint32_t((q.ox[k] - lo[0]) * scale[0]), uint32_t((q.oy[k] - lo[1]) * scale[1]),
+				uint32_t((q.oz[k] - lo[2]) * scale[2]));
+			uint32_t octant = (q.dx[k] < 0 ? 1u : 0u) | (q.dy[k] < 0 ? 2u : 0u) | (q.dz[k] < 0 ? 4u : 0u);
+			batch.keys[k] = (uint64_t((cell << 3) | octant) << 32) | uint32_t(k);
+		}
+		std::sort(batch.keys.begin(), batch.keys.end());
+
+		path_queue& sorted = batch.sorted;
+		if (sorted.ox.size() < q.ox.size())
+			sorted.resize(int(q.ox.size()));
+		for (int k = 0; k < q.size; k++) {
+			sorted.copy(q, int(batch.keys[k] & 0xffffffff), k);
+		}
+		sorted.size = q.size;
+		q.swap(sorted);
+	}
+
+	void finish(int segments) const {
+		if (stats != nullptr)
+			stats->record(segments);
+		RT_COUNT(paths);
+		RT_COUNT_N(rays, segments);
+		RT_COUNT_DEPTH(segments);
+	}
+
+private:
+	int max_depth;
+	int roulette_depth;
+	path_stats* stats;
+};
+
+#endif
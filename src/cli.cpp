@@ -0,0 +1,644 @@
+// Headless renderer: the progressive scenes of the viewer without a window,
+// for batch and benchmark runs. Writes a binary PPM and prints timings.
+//
+// Usage: raytracer-cli [options]
+//   --scene diffuse|normals|spheres   default diffuse
+//   --size WxH                        default 800x800
+//   --spp N                           samples per pixel, default 16
+//   --max-depth N                     default 50
+//   --threads N                       default one per core
+//   --seed N                          default 0
+//   --spheres N                       sphere count of the spheres scene, default 1000
+//   --scene-file FILE                 render the spheres and camera of a scene
+//                                     file instead (see scene_file.h), shaded as
+//                                     --scene says; its settings are defaults
+//                                     for the options above
+//   --save-scene FILE                 write the scene rendered as a scene file
+//   --packets                         trace primary rays as 8x8 packets
+//   --no-roulette                     trace every path to max-depth
+//   --adaptive ERROR                  adaptive sampling: spp becomes the average
+//                                     budget, pixels stop at this relative error
+//   --heatmap FILE                    also write the samples per pixel as a PPM
+//   --output FILE                     default out.ppm
+//   --checkpoint FILE                 save the render to FILE between passes
+//   --checkpoint-interval SECONDS     at most this often, default 60
+//   --resume FILE                     continue the render saved in FILE with
+//                                     its settings and scene file, which must
+//                                     be unchanged (and keep saving to FILE)
+//   --compare FILE                    print the RMSE and PSNR against a PPM
+//                                     of the same size, e.g. a double
+//                                     precision render of the same settings
+//   --order row|morton|hilbert        order of the tiles, of the pixels in a
+//                                     tile and of the accumulation buffer;
+//                                     the image is the same, default row
+//   --sampler NAME                    independent, stratified, sobol or
+//                                     bluenoise: where the pixel jitter,
+//                                     roulette and bounce numbers come from
+//                                     (see sampler.h), default independent
+//   --trace FILE                      write a timeline of the run as Chrome
+//                                     trace JSON, for Perfetto
+//   --workers ADDRESS,...             render the tiles on worker processes
+//                                     (host:port or unix:PATH) instead of here
+//   --tile-timeout SECONDS            drop a worker silent for this long
+//   --worker ADDRESS                  be a worker: listen on ADDRESS and
+//                                     render tiles for coordinators, forever
+
+#include <rtweekend.h>
+#include <hittable_list.h>
+#include <camera.h>
+#include <bvh.h>
+#include <compiled_scene.h>
+#include <render_engine.h>
+#include <accumulation_buffer.h>
+#include <path_tracer.h>
+#include <sampler.h>
+#include <progressive_renderer.h>
+#include <render_stats.h>
+#include <trace.h>
+#include <distributed.h>
+#include <checkpoint.h>
+#include <scene_file.h>
+#include <scenes.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct options {
+    std::string scene = "diffuse";
+    int width = 800;
+    int height = 800;
+    int samples_per_pixel = 16;
+    int max_depth = 50;
+    int threads = 0;
+    int seed = 0;
+    int spheres = 1000;
+    bool packets = false;
+    bool roulette = true;
+    std::string output = "out.ppm";
+    std::string compare;
+    double adaptive_error = 0;  // 0: uniform sampling
+    std::string heatmap;
+    std::string checkpoint;
+    double checkpoint_interval = 60;
+    std::string resume;
+    std::string scene_file;
+    std::string save_scene;
+    std::string trace;
+    std::vector<std::string> workers;
+    double tile_timeout = 0;
+    std::string worker;
+    pixel_order order = pixel_order::row_major;
+    sampler_type sampler = sampler_type::independent;
+};
+
+static void usage() {
+    fprintf(stderr,
+        "usage: raytracer-cli [--scene diffuse|normals|spheres] [--size WxH] [--spp N]\n"
+        "                     [--max-depth N] [--threads N] [--seed N] [--spheres N]\n"
+        "                     [--packets] [--no-roulette] [--adaptive ERROR] [--heatmap FILE]\n"
+        "                     [--output FILE] [--compare FILE] [--checkpoint FILE]\n"
+        "                     [--checkpoint-interval SECONDS] [--resume FILE]\n"
+        "                     [--scene-file FILE] [--save-scene FILE] [--trace FILE]\n"
+        "                     [--workers ADDRESS,...] [--tile-timeout SECONDS]\n"
+        "                     [--order row|morton|hilbert]\n"
+        "                     [--sampler independent|stratified|sobol|bluenoise]\n"
+        "       raytracer-cli --worker ADDRESS [--threads N]\n");
+}
+
+static bool parse_options(int argc, char** argv, options& opt) {
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--packets") {
+            opt.packets = true;
+            continue;
+        }
+        if (arg == "--no-roulette") {
+            opt.roulette = false;
+            continue;
+        }
+
+        const char* options_with_value[] = { "--scene", "--size", "--spp", "--max-depth", "--threads", "--seed", "--spheres", "--adaptive", "--heatmap", "--output", "--compare",
+            "--checkpoint", "--checkpoint-interval", "--resume", "--scene-file", "--save-scene", "--trace", "--workers", "--tile-timeout", "--worker", "--order", "--sampler" };
+        bool known = false;
+        for (const char* name : options_with_value)
+            known = known || arg == name;
+        if (!known) {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+        if (a + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++a];
+
+        if (arg == "--scene") {
+            opt.scene = value;
+        }
+        else if (arg == "--size") {
+            if (sscanf(value, "%dx%d", &opt.width, &opt.height) != 2) {
+                fprintf(stderr, "bad size '%s', expected WxH\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--spp") {
+            opt.samples_per_pixel = atoi(value);
+        }
+        else if (arg == "--max-depth") {
+            opt.max_depth = atoi(value);
+        }
+        else if (arg == "--threads") {
+            opt.threads = atoi(value);
+        }
+        else if (arg == "--seed") {
+            opt.seed = atoi(value);
+        }
+        else if (arg == "--spheres") {
+            opt.spheres = atoi(value);
+        }
+        else if (arg == "--adaptive") {
+            opt.adaptive_error = atof(value);
+        }
+        else if (arg == "--heatmap") {
+            opt.heatmap = value;
+        }
+        else if (arg == "--checkpoint") {
+            opt.checkpoint = value;
+        }
+        else if (arg == "--checkpoint-interval") {
+            opt.checkpoint_interval = atof(value);
+        }
+        else if (arg == "--resume") {
+            opt.resume = value;
+        }
+        else if (arg == "--scene-file") {
+            opt.scene_file = value;
+        }
+        else if (arg == "--save-scene") {
+            opt.save_scene = value;
+        }
+        else if (arg == "--trace") {
+            opt.trace = value;
+        }
+        else if (arg == "--workers") {
+            opt.workers.clear();
+            std::string list = value;
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t comma = std::min(list.find(',', start), list.size());
+                if (comma > start)
+                    opt.workers.push_back(list.substr(start, comma - start));
+                start = comma + 1;
+            }
+        }
+        else if (arg == "--tile-timeout") {
+            opt.tile_timeout = atof(value);
+        }
+        else if (arg == "--worker") {
+            opt.worker = value;
+        }
+        else if (arg == "--order") {
+            std::string name = value;
+            if (name == "row")
+                opt.order = pixel_order::row_major;
+            else if (name == "morton")
+                opt.order = pixel_order::morton;
+            else if (name == "hilbert")
+                opt.order = pixel_order::hilbert;
+            else {
+                fprintf(stderr, "unknown order '%s'\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--sampler") {
+            const sampler_type types[] = { sampler_type::independent, sampler_type::stratified, sampler_type::sobol, sampler_type::blue_noise };
+            bool found = false;
+            for (sampler_type type : types) {
+                if (value == std::string(sampler_name(type))) {
+                    opt.sampler = type;
+                    found = true;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "unknown sampler '%s'\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--output") {
+            opt.output = value;
+        }
+        else {
+            opt.compare = value;
+        }
+    }
+
+    if (opt.scene != "diffuse" && opt.scene != "normals" && opt.scene != "spheres") {
+        fprintf(stderr, "unknown scene '%s'\n", opt.scene.c_str());
+        return false;
+    }
+    if (opt.width < 2 || opt.height < 2 || opt.samples_per_pixel < 1) {
+        fprintf(stderr, "size must be at least 2x2 and spp at least 1\n");
+        return false;
+    }
+    if (!opt.workers.empty() && (opt.packets || opt.sampler != sampler_type::independent || opt.adaptive_error > 0 || !opt.checkpoint.empty() || !opt.resume.empty())) {
+        fprintf(stderr, "--workers renders every pixel at the full spp with the independent sampler, without packets, adaptive sampling or checkpoints\n");
+        return false;
+    }
+    return true;
+}
+
+// The settings a checkpoint records, and back.
+static render_settings checkpoint_settings(const options& opt) {
+    render_settings settings;
+    settings.set_scene(opt.scene);
+    settings.scene_size = opt.scene == "spheres" ? opt.spheres : 0;
+    settings.target_passes = opt.samples_per_pixel;
+    settings.max_depth = opt.max_depth;
+    settings.seed = opt.seed;
+    settings.roulette = opt.roulette;
+    settings.packets = opt.packets;
+    settings.adaptive = opt.adaptive_error > 0;
+    settings.target_error = float(opt.adaptive_error);
+    settings.sampler = int32_t(opt.sampler);
+    settings.set_scene_file(opt.scene_file);
+    return settings;
+}
+
+static void apply_settings(const render_settings& settings, int width, int height, options& opt) {
+    opt.scene = settings.scene;
+    if (settings.scene_size > 0)
+        opt.spheres = settings.scene_size;
+    opt.width = width;
+    opt.height = height;
+    opt.samples_per_pixel = settings.target_passes;
+    opt.max_depth = settings.max_depth;
+    opt.seed = settings.seed;
+    opt.roulette = settings.roulette != 0;
+    opt.packets = settings.packets != 0;
+    opt.adaptive_error = settings.adaptive ? settings.target_error : 0;
+    opt.sampler = sampler_type(settings.sampler);
+}
+
+// Binary PPM, top row first (the renderer's row 0 is the bottom of the image).
+static bool write_ppm(const std::string& path, const std::vector<uint8_t>& rgba, int width, int height) {
+    RT_TRACE_ZONE("write image");
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<uint8_t> row(size_t(width) * 3);
+    for (int j = height - 1; j >= 0; j--) {
+        for (int i = 0; i < width; i++) {
+            const uint8_t* p = &rgba[(size_t(j) * width + i) * 4];
+            row[i * 3] = p[0];
+            row[i * 3 + 1] = p[1];
+            row[i * 3 + 2] = p[2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    return fclose(file) == 0;
+}
+
+// Reads a binary PPM written by write_ppm into RGB bytes.
+static bool read_ppm(const std::string& path, std::vector<uint8_t>& rgb, int& width, int& height) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    int max_value = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", &width, &height, &max_value) == 3 && max_value == 255 && fgetc(file) != EOF;
+    if (ok) {
+        rgb.resize(size_t(width) * height * 3);
+        ok = fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+// Empty when built with RT_NO_STATS: nothing was counted.
+static void print_render_stats(const render_stats::snapshot& s) {
+    const render_counters& c = s.totals;
+    if (c.rays == 0)
+        return;
+    printf("rays       %.3f M in %d passes, %.3f M/s\n", 1e-6 * c.rays, s.passes, 1e-6 * s.rays_per_second());
+    printf("per ray    %.2f sphere tests, %.2f list hits, %.2f bvh nodes\n", s.per_ray(c.sphere_tests),
+        s.per_ray(c.list_hits), s.per_ray(c.bvh_nodes));
+    if (c.paths > 0) {
+        printf("path rays ");
+        for (int k = 0; k < render_counters::depth_buckets; k++) {
+            if (c.depth[k] > 0)
+                printf(" %d%s:%.1f%%", k + 1, k + 1 == render_counters::depth_buckets ? "+" : "", 100.0 * c.depth[k] / c.paths);
+        }
+        printf("\n");
+    }
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// --worker: serves coordinators one after another until killed.
+static int run_worker(const options& opt) {
+    net_socket listener;
+    std::string error;
+    if (!listener.listen(opt.worker, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    render_engine engine(opt.threads);
+    tile_worker worker(engine);
+    printf("worker     listening on %s, %d threads\n", opt.worker.c_str(), engine.thread_count());
+    fflush(stdout);
+    while (true) {
+        net_socket connection = listener.accept();
+        if (!connection.is_open())
+            continue;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = worker.run(connection, error);
+        printf("job        %zu spheres, %d tiles in %.3f s%s%s\n", worker.sphere_count, worker.tiles_rendered, seconds_since(start),
+            ok ? "" : ", stopped: ", ok ? "" : error.c_str());
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--help") == 0 || strcmp(argv[a], "-h") == 0) {
+            usage();
+            return 0;
+        }
+    }
+
+    options opt;
+    if (!parse_options(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+    if (!opt.trace.empty()) {
+        RT_TRACE_THREAD("main");
+        trace_log::global().start();
+    }
+    if (!opt.worker.empty())
+        return run_worker(opt);
+
+    // a resumed render continues on the scene file it was started with
+    accumulation_buffer accum;
+    accum.set_layout(opt.order);
+    render_settings resumed;
+    if (!opt.resume.empty()) {
+        if (!load_checkpoint(opt.resume, resumed, accum)) {
+            fprintf(stderr, "cannot resume from %s: not a checkpoint of this version\n", opt.resume.c_str());
+            return 1;
+        }
+        if (!resumed.scene_file_unchanged()) {
+            fprintf(stderr, "cannot resume from %s: scene file %s is missing or has changed\n", opt.resume.c_str(), resumed.scene_file);
+            return 1;
+        }
+        opt.scene_file = resumed.scene_file;
+    }
+
+    scene_file file;
+    double load_seconds = 0;
+    if (!opt.scene_file.empty()) {
+        auto load_start = std::chrono::steady_clock::now();
+        std::string error;
+        if (!file.load(opt.scene_file, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        load_seconds = seconds_since(load_start);
+
+        // the file's settings, then the command line again on top of them
+        const scene_settings& s = file.settings;
+        options with_file;
+        if (s.width > 0 && s.height > 0) {
+            with_file.width = s.width;
+            with_file.height = s.height;
+        }
+        if (s.samples_per_pixel > 0)
+            with_file.samples_per_pixel = s.samples_per_pixel;
+        if (s.max_depth >= 0)
+            with_file.max_depth = s.max_depth;
+        if (s.seed >= 0)
+            with_file.seed = s.seed;
+        parse_options(argc, argv, with_file);
+        with_file.scene_file = opt.scene_file;
+        opt = with_file;
+    }
+
+    if (!opt.resume.empty()) {
+        apply_settings(resumed, accum.width(), accum.height(), opt);
+        if (opt.checkpoint.empty())
+            opt.checkpoint = opt.resume;
+    }
+    else {
+        accum.resize(opt.width, opt.height);
+    }
+
+    auto build_start = std::chrono::steady_clock::now();
+    // the spheres scene is allocated from an arena, one block per MB instead of one allocation per sphere
+    scene_arena arena;
+    hittable_list world;
+    if (!opt.scene_file.empty())
+        world = file.make_world(&arena);
+    else
+        world = opt.scene == "spheres" ? random_sphere_scene(opt.spheres, 1, &arena) : two_sphere_scene();
+    // big scenes always go through a bvh, as do packets
+    bool use_bvh = opt.packets || world.objects.size() > 64;
+    std::unique_ptr<bvh> tree;
+    std::unique_ptr<compiled_scene> compiled;
+    if (use_bvh)
+        tree.reset(new bvh(world));
+    else
+        compiled.reset(new compiled_scene(world));
+    const hittable& target = use_bvh ? static_cast<const hittable&>(*tree) : *compiled;
+    double build_seconds = seconds_since(build_start);
+
+    render_engine engine(opt.threads);
+    engine.order = opt.order;
+    camera cam = opt.scene_file.empty() ? camera() : file.make_camera(opt.width, opt.height);
+
+    if (!opt.save_scene.empty()) {
+        scene_file out;
+        out.add(world);
+        if (!opt.scene_file.empty())
+            out.view = file.view;
+        out.settings.width = opt.width;
+        out.settings.height = opt.height;
+        out.settings.samples_per_pixel = opt.samples_per_pixel;
+        out.settings.max_depth = opt.max_depth;
+        out.settings.seed = opt.seed;
+        if (!out.write_text(opt.save_scene)) {
+            fprintf(stderr, "cannot write %s\n", opt.save_scene.c_str());
+            return 1;
+        }
+    }
+
+    path_stats stats;
+    path_tracer tracer(opt.max_depth, opt.roulette ? 3 : opt.max_depth, &stats);
+
+    progressive_renderer renderer(engine, accum);
+    renderer.target_passes = opt.samples_per_pixel;
+    renderer.seed = opt.seed;
+    renderer.adaptive = opt.adaptive_error > 0;
+    renderer.target_error = opt.adaptive_error;
+    renderer.sampler = opt.sampler;
+    int resumed_passes = accum.passes();
+    long long resumed_samples = accum.total_samples();
+    int checkpoints = 0;
+    if (!opt.checkpoint.empty()) {
+        render_settings settings = checkpoint_settings(opt);
+        if (settings.scene_file[0] == '\0' && !opt.scene_file.empty()) {
+            fprintf(stderr, "cannot checkpoint: scene file path %s too long or unreadable\n", opt.scene_file.c_str());
+            return 1;
+        }
+        renderer.checkpoint_seconds = opt.checkpoint_interval;
+        renderer.checkpoint = [&, settings] {
+            if (save_checkpoint(opt.checkpoint, settings, accum))
+                checkpoints++;
+            else
+                fprintf(stderr, "cannot write checkpoint %s\n", opt.checkpoint.c_str());
+        };
+    }
+
+    int width = opt.width;
+    int height = opt.height;
+    render_stats::global().reset();
+    auto render_start = std::chrono::steady_clock::now();
+    tile_coordinator coordinator;
+    if (!opt.workers.empty()) {
+        distributed_job job;
+        job.width = width;
+        job.height = height;
+        job.samples_per_pixel = opt.samples_per_pixel;
+        job.max_depth = opt.max_depth;
+        job.seed = opt.seed;
+        job.roulette = opt.roulette;
+        job.normals = opt.scene == "normals";
+        job.use_bvh = use_bvh;
+        job.cam = cam;
+        scene_file spheres;
+        spheres.add(world);
+        job.spheres.assign(spheres.spheres(), spheres.spheres() + spheres.sphere_count());
+
+        coordinator.workers = opt.workers;
+        coordinator.timeout_seconds = opt.tile_timeout;
+        std::string error;
+        if (!coordinator.render(job, accum, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    else if (opt.scene == "normals") {
+        renderer.accumulate([&](int i, int j) {
+            double du, dv;
+            sample_2d(du, dv);
+            auto u = real((i + du) / (width - 1));
+            auto v = real((j + dv) / (height - 1));
+            return normal_color(cam.get_ray(u, v), target);
+        });
+    }
+    else if (opt.packets) {
+        renderer.accumulate_packets(cam, target, [&](const ray& r, bool hit, const hit_record& rec) {
+            return tracer.trace_from_hit(r, hit, rec, target);
+        });
+    }
+    else {
+        renderer.accumulate([&](int i, int j) {
+            double du, dv;
+            sample_2d(du, dv);
+            auto u = real((i + du) / (width - 1));
+            auto v = real((j + dv) / (height - 1));
+            return tracer.trace(cam.get_ray(u, v), target);
+        });
+    }
+    double render_seconds = seconds_since(render_start);
+
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    accum.resolve(rgba.data(), opt.scene != "normals");
+    if (!write_ppm(opt.output, rgba, width, height)) {
+        fprintf(stderr, "cannot write %s\n", opt.output.c_str());
+        return 1;
+    }
+    int max_count = accum.max_sample_count();
+    if (!opt.heatmap.empty()) {
+        std::vector<uint8_t> heat(rgba.size());
+        accum.resolve_sample_counts(heat.data(), max_count);
+        if (!write_ppm(opt.heatmap, heat, width, height)) {
+            fprintf(stderr, "cannot write %s\n", opt.heatmap.c_str());
+            return 1;
+        }
+    }
+
+    double samples = double(accum.total_samples() - resumed_samples);
+    printf("precision  %s\n", sizeof(real) == sizeof(float) ? "float" : "double");
+    printf("scene      %s (%d objects%s)\n", opt.scene.c_str(), static_cast<int>(world.objects.size()), use_bvh ? ", bvh" : "");
+    if (!opt.scene_file.empty())
+        printf("load       %.3f s, %s (%s)\n", load_seconds, opt.scene_file.c_str(), file.from_cache() ? "mapped cache" : "parsed, cache written");
+    printf("image      %dx%d, %d spp, max_depth %d, %d threads, %s order, %s sampler\n", width, height, opt.samples_per_pixel, opt.max_depth,
+        engine.thread_count(), pixel_order_name(opt.order), sampler_name(opt.sampler));
+    if (arena.object_count() > 0)
+        printf("build      %.3f s (arena %.1f MB)\n", build_seconds, arena.bytes_reserved() / double(1 << 20));
+    else
+        printf("build      %.3f s\n", build_seconds);
+    if (!opt.resume.empty())
+        printf("resumed    %s after %d passes\n", opt.resume.c_str(), resumed_passes);
+    printf("render     %.3f s\n", render_seconds);
+    printf("samples/s  %.3f M\n", 1e-6 * samples / render_seconds);
+    if (renderer.adaptive)
+        printf("adaptive   error %g: %.2f spp average, %d max, %d pixels not converged\n", opt.adaptive_error,
+            accum.total_samples() / (double(width) * height), max_count, renderer.active_pixels());
+    if (stats.paths > 0)
+        printf("avg path   %.3f rays\n", stats.average_length());
+    print_render_stats(render_stats::global().read());
+    for (const tile_coordinator::worker_report& w : coordinator.reports) {
+        printf("worker     %s: %d tiles%s%s\n", w.address.c_str(), w.tiles, w.failed ? ", failed: " : "", w.failed ? w.error.c_str() : "");
+    }
+    if (coordinator.reassigned > 0)
+        printf("reassigned %d tiles\n", coordinator.reassigned);
+    printf("output     %s\n", opt.output.c_str());
+    if (!opt.checkpoint.empty())
+        printf("checkpoint %s, %d saved\n", opt.checkpoint.c_str(), checkpoints);
+    if (!opt.trace.empty()) {
+        trace_log::global().stop();
+        size_t events;
+        uint64_t dropped;
+        if (!trace_log::global().write_chrome_json(opt.trace, &events, &dropped)) {
+            fprintf(stderr, "cannot write %s\n", opt.trace.c_str());
+            return 1;
+        }
+        printf("trace      %s, %zu zones%s\n", opt.trace.c_str(), events, dropped > 0 ? " (buffers full, some dropped)" : "");
+    }
+
+    if (!opt.compare.empty()) {
+        std::vector<uint8_t> reference;
+        int reference_width, reference_height;
+        if (!read_ppm(opt.compare, reference, reference_width, reference_height) || reference_width != width || reference_height != height) {
+            fprintf(stderr, "cannot compare with %s: not a %dx%d binary PPM\n", opt.compare.c_str(), width, height);
+            return 1;
+        }
+        double squared_error = 0;
+        int differing = 0;
+        for (int j = 0; j < height; j++) {
+            for (int i = 0; i < width; i++) {
+                const uint8_t* a = &rgba[(size_t(j) * width + i) * 4];
+                const uint8_t* b = &reference[(size_t(height - 1 - j) * width + i) * 3];
+                bool same = true;
+                for (int c = 0; c < 3; c++) {
+                    double d = double(a[c]) - b[c];
+                    squared_error += d * d;
+                    same = same && d == 0;
+                }
+                differing += same ? 0 : 1;
+            }
+        }
+        double rmse = std::sqrt(squared_error / (double(width) * height * 3));
+        printf("compare    %s: rmse %.3f, psnr %.2f dB, %.2f%% pixels differ\n", opt.compare.c_str(), rmse,
+            rmse > 0 ? 20 * std::log10(255 / rmse) : infinity, 100.0 * differing / (double(width) * height));
+    }
+    return 0;
+}
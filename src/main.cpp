@@ -17,72 +17,153 @@
 
 //#include<color.h>
 #include <rtweekend.h>
+#include <color.h>
 #include <hittable_list.h>
 #include <sphere.h>
 #include <camera.h>
+#include <bvh.h>
+#include <render_engine.h>
+#include <render_job.h>
+#include <accumulation_buffer.h>
+#include <path_tracer.h>
+#include <sampler.h>
+#include <progressive_renderer.h>
+#include <checkpoint.h>
+#include <dirty_tiles.h>
+#include <texture_stream.h>
+#include <scene_file.h>
+#include <scenes.h>
+#include <compiled_scene.h>
+#include <render_stats.h>
+#include <trace.h>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 
 int inputSize[2]{ 1000, 1000 };
 ImVec2 imageSize(1000, 1000);
 uint8_t* pixels = nullptr;
 int samples_per_pixel = 1;
 int max_depth = 50;
+bool use_packets = false;   // trace primary rays as 8x8 packets through a bvh
+int render_seed = 0;        // same seed and settings, same image
+bool use_roulette = true;   // end dim paths early with russian roulette
+bool adaptive_sampling = false; // "sample" becomes the average budget, see progressive_renderer
+float adaptive_error = 0.01f;   // relative error at which a pixel stops
+int sampler_index = 0;          // sampler_type: independent, stratified, sobol, blue noise
+int pixel_order_index = 0;     // row, morton or hilbert: tiles, pixels in a tile and buffer layout
+bool show_heatmap = false;      // show the samples taken per pixel instead of the image
+bool save_checkpoints = false;  // save progressive renders to checkpointPath between passes
+int checkpoint_interval = 60;   // seconds
+char checkpointPath[260] = "render.ckpt";
+char sceneFilePath[260] = "";   // scene of the progressive items, built in when empty
+bool tracing = false;           // record trace zones, see trace.h
+char tracePath[260] = "render.trace.json";
+int thread_count = thread_pool::default_thread_count();
+render_engine engine(thread_count);
+
+render_job job(engine);
+// guards imageSize and the pixels allocation against the UI thread; the
+// pixel bytes themselves are written by the render without it
+std::mutex pixelsMutex;
+dirty_tiles pixelsDirty;    // tiles of pixels written since the last upload
+
+accumulation_buffer accum;
+int accumTarget = 0;    // passes (average samples when adaptive) the current job accumulates up to
+std::vector<uint8_t> heatmapPixels;   // show_heatmap's view of accum
+int renderedItem = -1;
+render_settings currentSettings();
+
+// Samples per pixel taken so far, on average: the completed passes, unless
+// adaptive sampling skipped pixels.
+int averageSamples() {
+    int count = accum.width() * accum.height();
+    return count > 0 ? int(accum.total_samples() / count) : 0;
+}
+path_stats pathStats;   // path lengths of the current render
 
 void updateImageSize(int width, int height) {
+    RT_TRACE_ZONE("updateImageSize");
+    std::lock_guard<std::mutex> lock(pixelsMutex);
+
     imageSize.x = width;
     imageSize.y = height;
 
     if (pixels != nullptr)
         delete[] pixels;
 
-    pixels = new uint8_t[imageSize.x * imageSize.y * 4];
+    // zeroed, so a render in progress shows black where no tile landed yet
+    pixels = new uint8_t[width * height * 4]();
+    pixelsDirty.resize(width, height);
 }
 
 void fillPixels(color& pixel_color, int index, bool is_sample = false, bool fix_gamma = false) {
+    write_rgba(pixels, index, pixel_color, is_sample ? 1.0 / samples_per_pixel : 1.0, fix_gamma);
+}
 
-    double r = pixel_color.x();
-    double g = pixel_color.y();
-    double b = pixel_color.z();
-
-    if (is_sample) {
-        auto scale = 1.0 / samples_per_pixel;
-        r *= scale;
-        g *= scale;
-        b *= scale;
+/*
+    PROGRESSIVE ACCUMULATION
+    Each pass adds one sample per pixel to accum and resolves the pixel into
+    the display buffer right away (see progressive_renderer). Runs until
+    accumTarget passes are done or the job is cancelled; calling it again at
+    the same size keeps refining the samples already in accum instead of
+    starting over.
+*/
+progressive_renderer makeProgressiveRenderer(int width, int height, bool fix_gamma) {
+    if (accum.width() != width || accum.height() != height) {
+        updateImageSize(width, height);
+        // the heatmap reads accum from the UI thread
+        std::lock_guard<std::mutex> lock(pixelsMutex);
+        accum.resize(width, height);
     }
 
-    if (fix_gamma) {
-        r = sqrt(r);
-        g = sqrt(g);
-        b = sqrt(b);
+    progressive_renderer renderer(engine, accum);
+    renderer.target_passes = accumTarget;
+    renderer.adaptive = adaptive_sampling;
+    renderer.target_error = adaptive_error;
+    renderer.sampler = sampler_type(sampler_index);
+    if (save_checkpoints) {
+        render_settings settings = currentSettings();
+        std::string path = checkpointPath;
+        renderer.checkpoint_seconds = checkpoint_interval;
+        renderer.checkpoint = [settings, path] {
+            if (!save_checkpoint(path, settings, accum))
+                std::cout << "cannot write checkpoint " << path << std::endl;
+        };
     }
+    renderer.seed = render_seed;
+    renderer.display = pixels;
+    renderer.fix_gamma = fix_gamma;
+    return renderer;
+}
+
+template<typename Sample>
+void accumulateImage(int width, int height, bool fix_gamma, Sample sample) {
+    makeProgressiveRenderer(width, height, fix_gamma).accumulate(sample);
+}
 
-    pixels[index * 4] = static_cast<int>(255.999 * r);
-    pixels[index * 4 + 1] = static_cast<int>(255.999 * g);
-    pixels[index * 4 + 2] = static_cast<int>(255.999 * b);
-    pixels[index * 4 + 3] = 255;
+// Like accumulateImage, but the primary rays are traced as 8x8 packets.
+template<typename Shade>
+void accumulateImagePackets(int width, int height, bool fix_gamma, const camera& cam, const hittable& world, Shade shade) {
+    makeProgressiveRenderer(width, height, fix_gamma).accumulate_packets(cam, world, shade);
 }
 
 void outputSimpleImage() {
-    for (int i = 0; i < imageSize.x; i++)
-    {
-        for (int j = 0; j < imageSize.y; j++)
-        {
-            auto r = double(i) / (imageSize.x - 1);
-            auto g = double(j) / (imageSize.y - 1);
-            auto b = 0.25;
-
-            int ir = static_cast<int>(255.999 * r);
-            int ig = static_cast<int>(255.999 * g);
-            int ib = static_cast<int>(255.999 * b);
-
-            int index = i + j * imageSize.y;
-            pixels[index * 4] = ir;
-            pixels[index * 4 + 1] = ig;
-            pixels[index * 4 + 2] = ib;
-            pixels[index * 4 + 3] = 255;
-        }
-    }
+    engine.render(imageSize.x, imageSize.y, [&](int i, int j) {
+        auto r = double(i) / (imageSize.x - 1);
+        auto g = double(j) / (imageSize.y - 1);
+        auto b = 0.25;
+
+        int ir = static_cast<int>(255.999 * r);
+        int ig = static_cast<int>(255.999 * g);
+        int ib = static_cast<int>(255.999 * b);
+
+        int index = i + j * imageSize.y;
+        pixels[index * 4] = ir;
+        pixels[index * 4 + 1] = ig;
+        pixels[index * 4 + 2] = ib;
+        pixels[index * 4 + 3] = 255;
+    });
 }
 
 void outputRaytracingSimpleImage() {
@@ -107,30 +188,28 @@ void outputRaytracingSimpleImage() {
 
     updateImageSize(image_width, image_height);
 
-    for (int i = 0; i < imageSize.x; i++) {
-        for (int j = 0; j < imageSize.y; j++) {
-            auto u = double(i) / (imageSize.x - 1);
-            auto v = double(j) / (imageSize.y - 1);
-
-            // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
-            // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
-            ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
+    engine.render(imageSize.x, imageSize.y, [&](int i, int j) {
+        auto u = double(i) / (imageSize.x - 1);
+        auto v = double(j) / (imageSize.y - 1);
 
-            vec3 unit_direction = unit_vector(r.direction());
-            auto t = 0.5 * (unit_direction.y() + 1.0);
-            color c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+        // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
+        // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
+        ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
 
-            int ir = static_cast<int>(255.999 * c.x());
-            int ig = static_cast<int>(255.999 * c.y());
-            int ib = static_cast<int>(255.999 * c.z());
-
-            int index = i + j * imageSize.y;
-            pixels[index * 4] = ir;
-            pixels[index * 4 + 1] = ig;
-            pixels[index * 4 + 2] = ib;
-            pixels[index * 4 + 3] = 255;
-        }
-    }
+        vec3 unit_direction = unit_vector(r.direction());
+        auto t = 0.5 * (unit_direction.y() + 1.0);
+        color c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+
+        int ir = static_cast<int>(255.999 * c.x());
+        int ig = static_cast<int>(255.999 * c.y());
+        int ib = static_cast<int>(255.999 * c.z());
+
+        int index = i + j * imageSize.y;
+        pixels[index * 4] = ir;
+        pixels[index * 4 + 1] = ig;
+        pixels[index * 4 + 2] = ib;
+        pixels[index * 4 + 3] = 255;
+    });
 }
 
 bool hit_sphere(const point3& center, double radius, const ray& r) {
@@ -167,37 +246,35 @@ void outputRaySphere() {
 
     updateImageSize(image_width, image_height);
 
-    for (int i = 0; i < imageSize.x; i++) {
-        for (int j = 0; j < imageSize.y; j++) {
-            auto u = double(i) / (imageSize.x - 1);
-            auto v = double(j) / (imageSize.y - 1);
-
-            // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
-            // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
-            ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
-                
-            // calc hit sphere
-            color c;
-            if (hit_sphere(point3(0, 0, -2), 0.5, r)) {
-                c = color(1.0, 0.0, 0.0);
-            }
-            else {
-                vec3 unit_direction = unit_vector(r.direction());
-                auto t = 0.5 * (unit_direction.y() + 1.0);
-                c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
-            }
+    engine.render(imageSize.x, imageSize.y, [&](int i, int j) {
+        auto u = double(i) / (imageSize.x - 1);
+        auto v = double(j) / (imageSize.y - 1);
 
-            int ir = static_cast<int>(255.999 * c.x());
-            int ig = static_cast<int>(255.999 * c.y());
-            int ib = static_cast<int>(255.999 * c.z());
-
-            int index = i + j * imageSize.y;
-            pixels[index * 4] = ir;
-            pixels[index * 4 + 1] = ig;
-            pixels[index * 4 + 2] = ib;
-            pixels[index * 4 + 3] = 255;
+        // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
+        // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
+        ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
+            
+        // calc hit sphere
+        color c;
+        if (hit_sphere(point3(0, 0, -2), 0.5, r)) {
+            c = color(1.0, 0.0, 0.0);
         }
-    }
+        else {
+            vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5 * (unit_direction.y() + 1.0);
+            c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+        }
+
+        int ir = static_cast<int>(255.999 * c.x());
+        int ig = static_cast<int>(255.999 * c.y());
+        int ib = static_cast<int>(255.999 * c.z());
+
+        int index = i + j * imageSize.y;
+        pixels[index * 4] = ir;
+        pixels[index * 4 + 1] = ig;
+        pixels[index * 4 + 2] = ib;
+        pixels[index * 4 + 3] = 255;
+    });
 }
 
 /*
@@ -264,40 +341,38 @@ void outputRayColorNormalSphere() {
 
     updateImageSize(image_width, image_height);
 
-    for (int i = 0; i < imageSize.x; i++) {
-        for (int j = 0; j < imageSize.y; j++) {
-            auto u = double(i) / (imageSize.x - 1);
-            auto v = double(j) / (imageSize.y - 1);
-
-            // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
-            // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
-            ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
-
-            // calc hit sphere
-            color c;
-            auto t = hit_sphere_simple_ver2(point3(0, 0, -2), 0.5, r);
-            if (t > 0.0) {
-                c = color(1.0, 0.0, 0.0);
-                vec3 normal = unit_vector(r.at(t) - point3(0, 0, -2));
-                c = 0.5 * color(normal.x() + 1.0, normal.y() + 1.0, normal.z() + 1.0);
-            }
-            else {
-                vec3 unit_direction = unit_vector(r.direction());
-                auto t = 0.5 * (unit_direction.y() + 1.0);
-                c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
-            }
+    engine.render(imageSize.x, imageSize.y, [&](int i, int j) {
+        auto u = double(i) / (imageSize.x - 1);
+        auto v = double(j) / (imageSize.y - 1);
+
+        // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
+        // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
+        ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
+
+        // calc hit sphere
+        color c;
+        auto t = hit_sphere_simple_ver2(point3(0, 0, -2), 0.5, r);
+        if (t > 0.0) {
+            c = color(1.0, 0.0, 0.0);
+            vec3 normal = unit_vector(r.at(t) - point3(0, 0, -2));
+            c = 0.5 * color(normal.x() + 1.0, normal.y() + 1.0, normal.z() + 1.0);
+        }
+        else {
+            vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5 * (unit_direction.y() + 1.0);
+            c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+        }
 
-            int ir = static_cast<int>(255.999 * c.x());
-            int ig = static_cast<int>(255.999 * c.y());
-            int ib = static_cast<int>(255.999 * c.z());
+        int ir = static_cast<int>(255.999 * c.x());
+        int ig = static_cast<int>(255.999 * c.y());
+        int ib = static_cast<int>(255.999 * c.z());
 
-            int index = i + j * imageSize.y;
-            pixels[index * 4] = ir;
-            pixels[index * 4 + 1] = ig;
-            pixels[index * 4 + 2] = ib;
-            pixels[index * 4 + 3] = 255;
-        }
-    }
+        int index = i + j * imageSize.y;
+        pixels[index * 4] = ir;
+        pixels[index * 4 + 1] = ig;
+        pixels[index * 4 + 2] = ib;
+        pixels[index * 4 + 3] = 255;
+    });
 }
 
 
@@ -328,33 +403,57 @@ void outputRayColorNormalMultSphere() {
 
     updateImageSize(image_width, image_height);
 
-    for (int i = 0; i < imageSize.x; i++) {
-        for (int j = 0; j < imageSize.y; j++) {
-            auto u = double(i) / (imageSize.x - 1);
-            auto v = double(j) / (imageSize.y - 1);
+    engine.render(imageSize.x, imageSize.y, [&](int i, int j) {
+        auto u = double(i) / (imageSize.x - 1);
+        auto v = double(j) / (imageSize.y - 1);
 
-            // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
-            // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
-            ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
+        // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
+        // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
+        ray r = ray(origin, lower_left_corner + u * horizontal + v * vertical - origin);
 
-            // calc hit sphere
-            color c;
+        // calc hit sphere
+        color c;
 
-            hit_record rec;
-            if (world.hit(r, 0, infinity, rec)) {
-                c =  0.5 * (rec.normal + color(1, 1, 1));
-            }
-            else {
-                vec3 unit_direction = unit_vector(r.direction());
-                auto t = 0.5 * (unit_direction.y() + 1.0);
-                c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
-            }
-            int index = i + j * imageSize.y;
-            fillPixels(c, index, false);
+        hit_record rec;
+        if (world.hit(r, 0, infinity, rec)) {
+            c =  0.5 * (rec.normal + color(1, 1, 1));
+        }
+        else {
+            vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5 * (unit_direction.y() + 1.0);
+            c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+        }
+        int index = i + j * imageSize.y;
+        fillPixels(c, index, false);
+    });
+}
+
+
+// The scene in sceneFilePath, through its binary cache, if one is set and
+// loads; the two spheres and the default camera otherwise.
+hittable_list loadScene(camera& cam, int width, int height) {
+    RT_TRACE_ZONE("scene setup");
+    if (sceneFilePath[0] != '\0') {
+        scene_file file;
+        std::string error;
+        if (file.load(sceneFilePath, error)) {
+            cam = file.make_camera(width, height);
+            return file.make_world();
         }
+        std::cout << error << std::endl;
     }
+    cam = camera();
+    return two_sphere_scene();
 }
 
+// A compiled_scene to loop over, or a bvh once the scene is too big for that
+// or its primary rays go through packets, which only a bvh traces together.
+std::unique_ptr<hittable> flattenScene(const hittable_list& world, bool packets = false) {
+    RT_TRACE_ZONE("flatten scene");
+    if (packets || world.objects.size() > 64)
+        return std::unique_ptr<hittable>(new bvh(world));
+    return std::unique_ptr<hittable>(new compiled_scene(world));
+}
 
 void outputRayColorMultiSample() {
     // Canvas
@@ -362,66 +461,29 @@ void outputRayColorMultiSample() {
     int image_width = 800;
     int image_height = static_cast<int>(image_width / aspect_ratio);
 
-    // World
-    hittable_list world;
-    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5));
-    world.add(make_shared<sphere>(point3(0, -100.5, -1), 100));
-
-    // Camera and Viewport
+    // World and camera, flattened for rendering
     camera cam;
-
-    updateImageSize(image_width, image_height);
-
-    for (int i = 0; i < imageSize.x; i++) {
-        for (int j = 0; j < imageSize.y; j++) {
-
-            // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
-            // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
-            // calc hit sphere
-            color pixel_color(0, 0, 0);
-
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double2()) / (imageSize.x - 1);
-                auto v = (j + random_double2()) / (imageSize.y - 1);
-                ray r = cam.get_ray(u, v);
-
-                hit_record rec;
-                color c;
-                if (world.hit(r, 0, infinity, rec)) {
-                    c = 0.5 * (rec.normal + color(1, 1, 1));
-                }
-                else {
-                    vec3 unit_direction = unit_vector(r.direction());
-                    auto t = 0.5 * (unit_direction.y() + 1.0);
-                    c = (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
-                }
-                pixel_color += c;
-            }
-
-            int index = i + j * imageSize.y;
-            fillPixels(pixel_color, index, true);
-        }
-    }
+    hittable_list world = loadScene(cam, image_width, image_height);
+    std::unique_ptr<hittable> flat = flattenScene(world);
+    const hittable& target = *flat;
+
+    accumulateImage(image_width, image_height, false, [&](int i, int j) {
+
+        // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
+        // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
+        // calc hit sphere
+        double du, dv;
+        sample_2d(du, dv);
+        auto u = (i + du) / (image_width - 1);
+        auto v = (j + dv) / (image_height - 1);
+        ray r = cam.get_ray(u, v);
+
+        return normal_color(r, target);
+    });
 }
 
-color ray_color(const ray& r, const hittable& world, int depth) {
-
-    if (depth <= 0) {
-        return color(0, 0, 0);
-    }
-
-    hit_record rec;
-    if (world.hit(r, 0.001, infinity, rec)) {
-        // random point 
-        point3 target = rec.p + rec.normal + random_in_unit_sphere();
-        return 0.5 * ray_color(ray(rec.p, target - rec.p), world, depth - 1);
-    }
-    else {
-        vec3 unit_direction = unit_vector(r.direction());
-        auto t = 0.5 * (unit_direction.y() + 1.0);
-        return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
-    }
-
+path_tracer makePathTracer() {
+    return path_tracer(max_depth, use_roulette ? 3 : max_depth, &pathStats);
 }
 
 
@@ -431,38 +493,133 @@ void outPutRayColorRandomNormalSphere() {
     int image_width = 800;
     int image_height = static_cast<int>(image_width / aspect_ratio);
 
-    // World
-    hittable_list world;
-    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5));
-    world.add(make_shared<sphere>(point3(0, -100.5, -1), 100));
-
-    // Camera and Viewport
+    // World and camera, flattened for rendering
     camera cam;
+    hittable_list world = loadScene(cam, image_width, image_height);
+    bool packets = use_packets;
+    std::unique_ptr<hittable> flat = flattenScene(world, packets);
+    const hittable& target = *flat;
+
+    path_tracer tracer = makePathTracer();
+
+    if (packets) {
+        accumulateImagePackets(image_width, image_height, true, cam, target, [&](const ray& r, bool hit, const hit_record& rec) {
+            return tracer.trace_from_hit(r, hit, rec, target);
+        });
+        return;
+    }
 
-    updateImageSize(image_width, image_height);
+    accumulateImage(image_width, image_height, true, [&](int i, int j) {
+
+        // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
+        // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
+        // calc hit sphere
+        double du, dv;
+        sample_2d(du, dv);
+        auto u = (i + du) / (image_width - 1);
+        auto v = (j + dv) / (image_height - 1);
+        ray r = cam.get_ray(u, v);
+        return tracer.trace(r, target);
+    });
+}
+// the sampling paths render through accumulateImage()
+bool isProgressive(int item) {
+    return item == 5 || item == 6;
+}
 
-    for (int i = 0; i < imageSize.x; i++) {
-        for (int j = 0; j < imageSize.y; j++) {
+// the gamma those paths resolve with
+bool isGammaCorrected(int item) {
+    return item == 6;
+}
 
-            // lower_left_corner + u * horizontal + v * vertical ӿϵĵ
-            // lower_left_corner + u * horizontal + v * vertical - origin ԭָӿϵĵ
-            // calc hit sphere
-            color pixel_color(0, 0, 0);
+// The viewer's item index stands in for the scene name.
+render_settings currentSettings() {
+    render_settings settings;
+    settings.set_scene(std::to_string(renderedItem));
+    settings.target_passes = accumTarget;
+    settings.max_depth = max_depth;
+    settings.seed = render_seed;
+    settings.roulette = use_roulette;
+    settings.packets = use_packets;
+    settings.adaptive = adaptive_sampling;
+    settings.target_error = adaptive_error;
+    settings.sampler = sampler_index;
+    settings.set_scene_file(sceneFilePath);
+    return settings;
+}
 
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double2()) / (imageSize.x - 1);
-                auto v = (j + random_double2()) / (imageSize.y - 1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
-            }
+void startRender(int selected) {
+    engine.set_thread_count(thread_count);
+    renderedItem = selected;
+    pathStats.reset();
+    render_stats::global().reset();
 
-            int index = i + j * imageSize.y;
-            fillPixels(pixel_color, index, true, true);
+    job.start([selected] {
+        switch (selected)
+        {
+        case 0:
+            outputSimpleImage();
+            break;
+        case 1:
+            outputRaytracingSimpleImage();
+            break;
+        case 2:
+            outputRaySphere();
+            break;
+        case 3:
+            outputRayColorNormalSphere();
+            break;
+        case 4:
+            outputRayColorNormalMultSphere();
+            break;
+        case 5:
+            outputRayColorMultiSample();
+            break;
+        case 6:
+            outPutRayColorRandomNormalSphere();
+        default:
+            break;
+        }
+    });
+}
+
+// Continues the render saved in a checkpoint with its settings.
+bool resumeRender(const char* path) {
+    job.cancel();
+    job.wait();
+
+    render_settings settings;
+    int item = -1;
+    {
+        std::lock_guard<std::mutex> lock(pixelsMutex);
+        if (load_checkpoint(path, settings, accum) && settings.scene_file_unchanged())
+            item = atoi(settings.scene);
+        if (!isProgressive(item)) {
+            accum.resize(0, 0);
+            return false;
         }
     }
+    max_depth = settings.max_depth;
+    render_seed = settings.seed;
+    use_roulette = settings.roulette != 0;
+    use_packets = settings.packets != 0;
+    adaptive_sampling = settings.adaptive != 0;
+    adaptive_error = settings.target_error;
+    sampler_index = settings.sampler;
+    accumTarget = settings.target_passes;
+    strncpy(sceneFilePath, settings.scene_file, sizeof(sceneFilePath) - 1);
+
+    updateImageSize(accum.width(), accum.height());
+    accum.resolve(pixels, isGammaCorrected(item));
+    pixelsDirty.mark_all();
+    startRender(item);
+    return true;
 }
+
 int main(void)
 {
+    RT_TRACE_THREAD("ui");
+
     // glfw: initialize and configure
     glfwInit();
 
@@ -490,6 +647,8 @@ int main(void)
     ImVec4 clear_color = ImVec4(0.2f, 0.25f, 0.40f, 1.00f);
 
     bool showResult = false;
+    bool resumeFailed = false;
+    bool showStats = false;
 
     GLuint renderTexture;
     glGenTextures(1, &renderTexture);
@@ -501,6 +660,12 @@ int main(void)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTexture, 0);
 
+    // every engine render writes pixels; only the tiles it finished are uploaded
+    engine.tile_done = [](const tile& t) { pixelsDirty.mark(t); };
+    texture_stream renderStream;
+    bool heatmapShown = false;
+    double uploadMs = 0;    // CPU time of the texture upload, averaged over frames
+
     const char* items[] = { 
         "SimpleImage", 
         "RaySimpleImage", 
@@ -539,6 +704,17 @@ int main(void)
 
         ImGui::InputInt("sample", &samples_per_pixel);
         ImGui::InputInt("max_depth", &max_depth);
+        ImGui::SliderInt("threads", &thread_count, 1, 2 * thread_pool::default_thread_count());
+        ImGui::Checkbox("ray packets", &use_packets);
+        ImGui::InputInt("seed", &render_seed);
+        ImGui::Checkbox("russian roulette", &use_roulette);
+        ImGui::InputText("scene file", sceneFilePath, sizeof(sceneFilePath));
+        ImGui::Checkbox("adaptive sampling", &adaptive_sampling);
+        ImGui::BeginDisabled(!adaptive_sampling);
+        ImGui::SliderFloat("target error", &adaptive_error, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+        ImGui::EndDisabled();
+        ImGui::Combo("pixel order", &pixel_order_index, "row\0morton\0hilbert\0");
+        ImGui::Combo("sampler", &sampler_index, "independent\0stratified\0sobol\0blue noise\0");
             
         ImGuiIO& io = ImGui::GetIO();
         float scale = 2.0f;
@@ -548,54 +724,124 @@ int main(void)
         if (ImGui::Button("Demo")) {
             show_demo_window = !show_demo_window;
         }
+        ImGui::SameLine();
+        ImGui::Checkbox("stats", &showStats);
+
+        // a capture runs from ticking "trace" until it is saved or ticked again
+        if (ImGui::Checkbox("trace", &tracing)) {
+            if (tracing)
+                trace_log::global().start();
+            else
+                trace_log::global().stop();
+        }
+        ImGui::SameLine();
+        ImGui::InputText("##trace file", tracePath, sizeof(tracePath));
+        ImGui::SameLine();
+        if (ImGui::Button("Save trace")) {
+            size_t zones = 0;
+            uint64_t dropped = 0;
+            if (trace_log::global().write_chrome_json(tracePath, &zones, &dropped))
+                std::cout << "trace " << tracePath << ": " << zones << " zones, " << dropped << " dropped" << std::endl;
+            else
+                std::cout << "cannot write trace " << tracePath << std::endl;
+        }
 
 
         if (ImGui::Button("Render")) {
-            imageSize.x = inputSize[0];
-            imageSize.y = inputSize[1];
-
-            if (pixels != nullptr)
-                delete[] pixels;
-
-            pixels = new uint8_t[imageSize.x * imageSize.y * 4];
+            // the previous job must stop writing before its buffer is replaced
+            job.cancel();
+            job.wait();
 
-
-            switch (item_current)
+            updateImageSize(inputSize[0], inputSize[1]);
             {
-            case 0:
-                outputSimpleImage();
-                break;
-            case 1:
-                outputRaytracingSimpleImage();
-                break;
-            case 2:
-                outputRaySphere();
-                break;
-            case 3:
-                outputRayColorNormalSphere();
-                break;
-            case 4:
-                outputRayColorNormalMultSphere();
-                break;
-            case 5:
-                outputRayColorMultiSample();
-                break;
-            case 6:
-                outPutRayColorRandomNormalSphere();
-            default:
-                break;
+                std::lock_guard<std::mutex> lock(pixelsMutex);
+                engine.order = pixel_order(pixel_order_index);
+                accum.set_layout(engine.order, engine.tile_size);
+                accum.resize(0, 0);
             }
+            accumTarget = samples_per_pixel;
+            startRender(item_current);
+            showResult = true;
+        }
+
+        // keep adding passes to the last progressive render instead of starting over
+        ImGui::SameLine();
+        ImGui::BeginDisabled(job.running() || !isProgressive(renderedItem) || accum.passes() == 0);
+        if (ImGui::Button("Refine")) {
+            accumTarget = averageSamples() + samples_per_pixel;
+            startRender(renderedItem);
             showResult = true;
         }
+        ImGui::EndDisabled();
+
+        ImGui::Checkbox("checkpoints", &save_checkpoints);
+        ImGui::InputText("checkpoint file", checkpointPath, sizeof(checkpointPath));
+        ImGui::InputInt("every (s)", &checkpoint_interval);
+        ImGui::BeginDisabled(job.running());
+        if (ImGui::Button("Resume")) {
+            resumeFailed = !resumeRender(checkpointPath);
+            showResult = !resumeFailed;
+        }
+        ImGui::EndDisabled();
+        if (resumeFailed) {
+            ImGui::SameLine();
+            ImGui::Text("cannot resume from %s", checkpointPath);
+        }
         ImGui::End();
 
         if (showResult)
         {
-            ImGui::SetNextWindowSize(imageSize + ImVec2(20, 35));
+            std::lock_guard<std::mutex> lock(pixelsMutex);
+
+            float statusHeight = ImGui::GetFrameHeightWithSpacing();
+            ImGui::SetNextWindowSize(imageSize + ImVec2(20, 35 + statusHeight));
             ImGui::Begin("result", &showResult);
 
-            glBindTexture(GL_TEXTURE_2D, renderTexture);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageSize.x, imageSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            ImGui::BeginDisabled(!job.running());
+            if (ImGui::Button("Cancel")) {
+                job.cancel();
+            }
+            ImGui::EndDisabled();
+            ImGui::SameLine();
+            ImGui::Checkbox("PBO", &renderStream.use_pbo);
+            ImGui::SameLine();
+            ImGui::Text("upload %.2f ms", uploadMs);
+            ImGui::SameLine();
+            if (isProgressive(renderedItem)) {
+                ImGui::Checkbox("heatmap", &show_heatmap);
+                ImGui::SameLine();
+                int passes = averageSamples();
+                float target = float(accumTarget > 0 ? accumTarget : 1);
+                float fraction = job.running() ? (passes + job.progress()) / target : passes / target;
+                char status[64];
+                snprintf(status, sizeof(status), "%d / %d spp, avg path %.2f%s", passes, accumTarget, pathStats.average_length(), job.cancelled() ? " (cancelled)" : "");
+                ImGui::ProgressBar(fraction, ImVec2(-1, 0), status);
+            }
+            else {
+                const char* status = job.running() ? nullptr : (job.cancelled() ? "cancelled" : "done");
+                ImGui::ProgressBar(job.running() ? job.progress() : 1.0f, ImVec2(-1, 0), status);
+            }
+
+            // the job keeps writing while we upload: a frame may show a tile
+            // half rewritten by the next pass, which is sent again once it is done
+            RT_TRACE_ZONE("texture upload");
+            auto uploadStart = std::chrono::steady_clock::now();
+            int width = int(imageSize.x);
+            int height = int(imageSize.y);
+            bool heatmap = show_heatmap && isProgressive(renderedItem) && accum.width() == width && accum.height() == height;
+            if (heatmap) {
+                heatmapPixels.resize(size_t(width) * height * 4);
+                accum.resolve_sample_counts(heatmapPixels.data(), accum.max_sample_count());
+                renderStream.upload_all(renderTexture, heatmapPixels.data(), width, height);
+            }
+            else {
+                if (heatmapShown)
+                    pixelsDirty.mark_all();
+                renderStream.upload(renderTexture, pixels, width, height, pixelsDirty);
+            }
+            heatmapShown = heatmap;
+            std::chrono::duration<double, std::milli> uploadTime = std::chrono::steady_clock::now() - uploadStart;
+            uploadMs += 0.05 * (uploadTime.count() - uploadMs);
 
             // ImVec2(0, 1) ½
             // ImVec2(1, 0) Ͻ
@@ -603,6 +849,30 @@ int main(void)
             ImGui::End();
         }
 
+        if (showStats)
+        {
+            // totals of the tiles finished so far in the current render
+            render_stats::snapshot stats = render_stats::global().read();
+            const render_counters& c = stats.totals;
+            ImGui::Begin("Stats", &showStats);
+#ifdef RT_NO_STATS
+            ImGui::Text("built with RT_NO_STATS, nothing is counted");
+#endif
+            ImGui::Text("rays          %.3f M", 1e-6 * c.rays);
+            ImGui::Text("passes        %d, last %.3f s", stats.passes, stats.last_pass_seconds);
+            double lastRate = stats.last_pass_seconds > 0 ? stats.last_pass_rays / stats.last_pass_seconds : 0;
+            ImGui::Text("rays/s        %.3f M, last pass %.3f M", 1e-6 * stats.rays_per_second(), 1e-6 * lastRate);
+            ImGui::Text("sphere tests  %.2f per ray", stats.per_ray(c.sphere_tests));
+            ImGui::Text("list hits     %.2f per ray", stats.per_ray(c.list_hits));
+            ImGui::Text("bvh nodes     %.2f per ray", stats.per_ray(c.bvh_nodes));
+            float depths[render_counters::depth_buckets];
+            for (int k = 0; k < render_counters::depth_buckets; k++) {
+                depths[k] = c.paths > 0 ? float(c.depth[k]) / c.paths : 0.0f;
+            }
+            ImGui::PlotHistogram("rays per path", depths, render_counters::depth_buckets, 0, nullptr, 0.0f, 1.0f, ImVec2(0, 80));
+            ImGui::End();
+        }
+
         if (show_demo_window) {
             ImGui::ShowDemoWindow(&show_demo_window);
         }
@@ -619,6 +889,10 @@ int main(void)
     }
 
     // Cleanup
+    renderStream.release();
+    job.cancel();
+    job.wait();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();